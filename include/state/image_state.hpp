@@ -1,9 +1,13 @@
 #pragma once
 
+#include <vector>
+
 #include "util/image.hpp"
 
 class ImageState {
 public:
+  enum Layer : unsigned { FRAME = 1 << 0, CHARACTER = 1 << 1, BACKGROUND = 1 << 2 };
+
   ImageState();
   Image frame, character, background, working;
   void resize();
@@ -12,4 +16,14 @@ public:
   void updateBackground(std::string path);
   void updateWorking(std::string path);
   void merge();
+
+  // size x size previews of this state with layer replaced by each candidate, composed across a few threads. The
+  // fixed layers are scaled (and for FRAME pre-blended) once for the whole batch; a candidate without pixels gives an
+  // empty result
+  std::vector<Image> composeBatch(Layer layer, const std::vector<Image>& candidates, int size) const;
+
+private:
+  // character pre-blended over background; only rebuilt when one of those two layers is dirty
+  Image composite;
+  unsigned dirty = CHARACTER | BACKGROUND;
 };
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// Opt-in heap allocation counter: with the COUNT_ALLOCATIONS CMake option the global operator new is replaced with one
+// that counts calls, so hot paths can check that they no longer allocate. Other builds keep the default allocator and
+// count() always returns 0.
+namespace allocations {
+// number of operator new calls made so far, across all threads
+size_t count();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+// RGBA8 compositing kernels shared by Image and ImageState.
+//
+// over() draws top onto bottom using top's alpha; rgb is (t*a + b*(255-a)) / 255 (truncated) and the output alpha is
+// opaque unless top is fully transparent, in which case bottom's alpha is kept. Chaining two calls reproduces the
+// original three layer merge bit for bit. output may alias top or bottom.
+namespace blend {
+void over(const unsigned char* top, const unsigned char* bottom, unsigned char* output, size_t pixels);
+
+// plain per-pixel implementation; the vector paths fall back to it for the remaining tail
+void overScalar(const unsigned char* top, const unsigned char* bottom, unsigned char* output, size_t pixels);
+
+// multiplies each pixel's alpha by alpha (0..1) through a lookup table; same truncation as the float expression
+void scaleAlpha(unsigned char* pixels, size_t count, float alpha);
+}
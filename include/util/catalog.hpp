@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Binary index over the extracted icon cache (categories, per-subcategory part lists, representative icon) so
+// browsing never has to walk the cache directories. Written after each extraction; rebuilt from a directory scan
+// plus the pack indexes (see pack.hpp) only when it is missing or stale.
+namespace catalog {
+struct Category {
+  std::string name;
+  std::string icon;
+};
+
+// collects the files reported by extract::extract and writes the index once extraction finishes
+class Builder {
+public:
+  void add(const std::filesystem::path& file);
+  // whether add() saw the file
+  bool contains(const std::filesystem::path& file) const;
+  std::vector<char> serialize();
+  bool write();
+
+private:
+  // category -> subcategory -> file names
+  std::map<std::string, std::map<std::string, std::vector<std::string>>> entries;
+};
+
+bool load();
+void invalidate();
+std::vector<Category> categories(std::string_view subcategory);
+std::vector<std::string> parts(std::string_view category, std::string_view subcategory);
+}
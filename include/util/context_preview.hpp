@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "state/image_state.hpp"
+
+// "Preview in context" for the part grids: each requested part comes back as the finished icon at thumbnail size,
+// composed against a fixed ImageState with layer swapped out. Requests made within the same frame (a page of cells)
+// are decoded and composed as one ImageState::composeBatch on a worker thread.
+class ContextPreview {
+public:
+  using Callback = std::function<void(Image&&)>;
+
+  ContextPreview(const ImageState& state, ImageState::Layer layer);
+  ~ContextPreview();
+
+  ContextPreview(const ContextPreview&) = delete;
+  ContextPreview& operator=(const ContextPreview&) = delete;
+
+  // done always runs on the main thread; the image is empty if the part could not be read or the preview was
+  // destroyed first
+  void request(const std::string& path, Callback done);
+
+private:
+  struct Request {
+    std::string path;
+    Callback done;
+  };
+
+  void run(std::stop_token token);
+
+  ImageState state;
+  ImageState::Layer layer;
+
+  std::mutex mutex;
+  std::condition_variable_any condition;
+  std::vector<Request> requests;
+
+  std::jthread worker;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+// Reusable easy handles sharing one DNS and TLS session cache, so back to back requests skip the lookup and the full
+// handshake. Each handle keeps its own connection cache across curl_easy_reset, so a reused handle also reuses its
+// keep-alive connection; that cache is not shared, since libcurl does not support one connection cache being used
+// from several threads at once. Handles come back reset; every request sets its options again. Safe to use from any
+// thread once curl_global_init has run.
+class CurlPool {
+public:
+  CurlPool(const CurlPool&) = delete;
+  CurlPool& operator=(const CurlPool&) = delete;
+  CurlPool(CurlPool&&)                 = delete;
+  CurlPool& operator=(CurlPool&&) = delete;
+
+  static CurlPool& instance()
+  {
+    static CurlPool pool;
+    return pool;
+  }
+
+  // a pooled handle borrowed for the duration of one request
+  class Handle {
+  public:
+    Handle()
+        : curl(CurlPool::instance().acquire())
+    {
+    }
+
+    ~Handle() { CurlPool::instance().release(curl); }
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+
+    operator CURL*() const { return curl; }
+
+  private:
+    CURL* curl;
+  };
+
+  // an idle handle, or a new one; nullptr if curl_easy_init failed
+  CURL* acquire();
+  void release(CURL* curl);
+
+private:
+  CurlPool();
+  ~CurlPool();
+
+  static void lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr);
+  static void unlockShare(CURL*, curl_lock_data data, void* userptr);
+
+  CURLSH* share = nullptr;
+  std::mutex mutex;
+  std::vector<CURL*> idle;
+  std::array<std::mutex, CURL_LOCK_DATA_LAST> locks;
+};
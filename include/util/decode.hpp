@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "util/image.hpp"
+
+// Decoders that downsample while they decode, one scanline at a time, straight into the target buffer, so a
+// multi-megapixel custom image never exists at full size. JPEGs are also reduced in the DCT (by 1/8 steps) to the
+// smallest size still covering the target. Anything that cannot be streamed (other formats, interlaced or Apple PNGs,
+// sources not larger than the target, packed parts) returns false and is left to the full decode in Image.
+namespace decode {
+// asked for the x by y output only once the header shows the source will stream, so a rejected file costs no buffer;
+// every output pixel is written, so the view need not be cleared
+using Target = std::function<MutableImageView()>;
+
+bool scaled(const std::string& path, int x, int y, const Target& target);
+}
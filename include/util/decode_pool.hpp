@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/image.hpp"
+
+// Decodes images for grid cells off the UI thread; results are handed back on the main thread via brls::sync.
+class DecodePool {
+public:
+  // owned by the requester; bumping it marks every request made under the previous value as stale
+  using Ticket   = std::shared_ptr<std::atomic_uint64_t>;
+  using Callback = std::function<void(Image&&)>;
+
+  DecodePool(const DecodePool&) = delete;
+  DecodePool& operator=(const DecodePool&) = delete;
+  DecodePool(DecodePool&&)                 = delete;
+  DecodePool& operator=(DecodePool&&) = delete;
+
+  static DecodePool& instance()
+  {
+    static DecodePool pool;
+    return pool;
+  }
+
+  // done always runs on the main thread; the image is empty if decoding failed or the ticket moved on first.
+  // a non-zero thumbnail size serves a square thumbnail of that size from the thumbnail store instead
+  void request(const std::string& path, const Ticket& ticket, Callback done, int thumbnail = 0);
+
+  // decode paths ahead of time (nearest first) while no request is waiting, replacing any prefetch still queued;
+  // a later request for the same path and size is served from the result without touching the disk
+  void prefetch(std::vector<std::string> paths, int thumbnail = 0);
+
+private:
+  DecodePool();
+
+  struct Job {
+    std::string path;
+    Ticket ticket;
+    uint64_t generation;
+    Callback done;
+    int thumbnail;
+  };
+
+  struct Prefetched {
+    std::string path;
+    int thumbnail;
+    Image image;
+  };
+
+  void run(std::stop_token token);
+  void warm(const std::string& path, int thumbnail);
+
+  std::mutex mutex;
+  std::condition_variable_any condition;
+  std::deque<Job> jobs;
+  std::deque<std::string> prefetches;
+  int prefetchThumbnail = 0;
+  // oldest first; entries leave when a request takes them or when the cache is full
+  std::deque<Prefetched> prefetched;
+  std::vector<std::jthread> workers;
+};
@@ -9,11 +9,18 @@ constexpr int OFF = 0;
 
 #include "extern/json.hpp"
 
+class RingBuffer;
+
 namespace download {
 void init();
 long downloadFile(
     const std::string& url, std::vector<std::uint8_t>& res, const std::string& output = "", int api = OFF);
 long downloadFile(const std::string& url, const std::string& output = "", int api = OFF);
+// downloads to output in up to connections parallel HTTP ranges when the server takes them, keeping output.state next
+// to the file so a dropped connection or a killed app resumes instead of starting over; plain downloadFile otherwise
+long downloadResumable(const std::string& url, const std::string& output, int connections = 1);
+// feeds the response body into pipe as it arrives and closes it when done; stops early if the reader aborts the pipe
+long downloadStream(const std::string& url, RingBuffer& pipe);
 long downloadPage(const std::string& url, std::string& res, const std::vector<std::string>& headers = {},
     const std::string& body = "");
 long getRequest(const std::string& url, nlohmann::ordered_json& res, const std::vector<std::string>& headers = {},
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+#include "util/image.hpp"
+
+// png is a single-pass writer on zlib: every row gets the Paeth filter and the stream is deflated with Z_RLE, skipping
+// both stb_image_write's per-row filter search and its deflate. On icon art it is several times faster and no
+// larger. jpg is stb_image_write's encoder writing to memory, so the account icon needs no temporary file. Both
+// append to out. encode.cpp also carries stb_image_write's implementation for the rest of the app.
+namespace encode {
+bool png(ImageView image, std::vector<unsigned char>& out);
+bool jpg(ImageView image, std::vector<unsigned char>& out, int quality = 90);
+}
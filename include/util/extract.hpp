@@ -1,8 +1,27 @@
 #pragma once
 
+#include <filesystem>
 #include <functional>
 #include <string>
 
+class RingBuffer;
+namespace manifest {
+class Manifest;
+}
+
 namespace extract {
-void extract(const std::string& filename, const std::string& workingPath, bool overwriteExisting);
+// onFile is called for every regular file entry in the archive, whether or not it was (re)written. With a manifest,
+// existing files are rewritten only when their content changed, files the archive no longer has are deleted, and the
+// manifest is saved after a complete pass; overwriteExisting then only applies to files the manifest does not know.
+// exists, when given, decides whether an entry is already in place instead of the filesystem, so parts served from the
+// packs count as present. Returns whether the pass was complete: every entry read and written, and the manifest saved.
+bool extract(const std::string& filename, const std::string& workingPath, bool overwriteExisting,
+    const std::function<void(const std::filesystem::path&)>& onFile = nullptr, manifest::Manifest* manifest = nullptr,
+    const std::function<bool(const std::filesystem::path&)>& exists = nullptr);
+
+// same, reading the archive from a pipe fed by download::downloadStream; the total entry count is unknown, so progress
+// is reported through ProgressEvent's file counter only
+bool extract(RingBuffer& pipe, const std::string& workingPath, bool overwriteExisting,
+    const std::function<void(const std::filesystem::path&)>& onFile = nullptr, manifest::Manifest* manifest = nullptr,
+    const std::function<bool(const std::filesystem::path&)>& exists = nullptr);
 }
\ No newline at end of file
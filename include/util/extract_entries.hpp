@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+
+struct archive;
+namespace manifest {
+class Manifest;
+}
+
+// The part of extract::extract that walks an opened libarchive handle and writes its entries out on a pool of writer
+// threads, applying the manifest. It needs neither borealis nor libnx; extract.cpp adds the storage check, logging
+// and the archive sources.
+namespace extract {
+struct Result {
+  int written    = 0;
+  int skipped    = 0; // left in place because the manifest says they did not change
+  size_t removed = 0; // deleted because the archive no longer has them
+  bool complete  = false; // every entry read and written, and the manifest saved
+  std::string error; // the first thing that went wrong, empty if nothing did
+};
+
+// exists replaces the filesystem check for whether an entry is already in place, e.g. to count packed parts; steps is
+// false when the entry count is not known upfront, e.g. while streaming
+Result extractEntries(struct archive* archive, const std::string& workingPath, bool overwriteExisting,
+    const std::function<void(const std::filesystem::path&)>& onFile, manifest::Manifest* manifest,
+    const std::function<bool(const std::filesystem::path&)>& exists, bool steps);
+}
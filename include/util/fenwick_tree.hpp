@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Prefix sums over a growable array with O(log n) point updates, prefix queries and offset lookups.
+class FenwickTree {
+public:
+  void assign(const std::vector<double>& values)
+  {
+    this->values = values;
+    tree.assign(values.size() + 1, 0);
+    for (size_t i = 1; i < tree.size(); i++) {
+      tree[i] += values[i - 1];
+      size_t parent = i + (i & -i);
+      if (parent < tree.size())
+        tree[parent] += tree[i];
+    }
+  }
+
+  void push(double value)
+  {
+    size_t i = tree.size();
+    values.push_back(value);
+    // node i covers (i - lowbit(i), i]
+    tree.push_back(value + prefix(i - 1) - prefix(i - (i & -i)));
+  }
+
+  void set(size_t index, double value)
+  {
+    double delta  = value - values[index];
+    values[index] = value;
+    for (size_t i = index + 1; i < tree.size(); i += i & -i)
+      tree[i] += delta;
+  }
+
+  // sum of the first count values
+  double prefix(size_t count) const
+  {
+    double res = 0;
+    for (size_t i = count < size() ? count : size(); i > 0; i -= i & -i)
+      res += tree[i];
+    return res;
+  }
+
+  // index of the value containing offset, i.e. the smallest i with prefix(i + 1) > offset; size() if none
+  size_t lowerBound(double offset) const
+  {
+    size_t pos = 0, step = 1;
+    while (step * 2 < tree.size())
+      step *= 2;
+
+    for (; step > 0; step /= 2) {
+      if (pos + step < tree.size() && tree[pos + step] <= offset) {
+        pos += step;
+        offset -= tree[pos];
+      }
+    }
+    return pos;
+  }
+
+  size_t size() const { return values.size(); }
+
+  void clear()
+  {
+    values.clear();
+    tree.clear();
+  }
+
+private:
+  std::vector<double> values;
+  std::vector<double> tree { 0 };
+};
@@ -1,8 +1,47 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <vector>
 
+// Non-owning RGBA pixels, e.g. of an Image or a pooled buffer; only valid while the buffer it points into is alive.
+// A MutableImageView converts to an ImageView.
+template <typename T> struct BasicImageView {
+  T* data = nullptr;
+  int x = 0, y = 0;
+
+  BasicImageView() = default;
+  BasicImageView(T* data, int x, int y)
+      : data(data)
+      , x(x)
+      , y(y)
+  {
+  }
+
+  template <typename U>
+    requires std::is_convertible_v<U*, T*>
+  BasicImageView(const BasicImageView<U>& other)
+      : data(other.data)
+      , x(other.x)
+      , y(other.y)
+  {
+  }
+
+  size_t pixels() const { return static_cast<size_t>(x) * y; }
+  size_t size() const { return pixels() * 4; }
+  explicit operator bool() const { return data != nullptr; }
+};
+
+using ImageView        = BasicImageView<const unsigned char>;
+using MutableImageView = BasicImageView<unsigned char>;
+
+// Pixel storage is reference counted: copies share one buffer, and the mutating operations (merge output,
+// applyAlpha, resize) detach first, so snapshots of an ImageState or layers assigned from a shared image are free.
+// Code writing to data directly must call mutableData() instead. 256x256 buffers come from PixelPool.
+//
+// The static operations take views, so they also work on buffers no Image owns.
 struct Image {
   struct HandleDeleter {
     void operator()(unsigned char* p) const
@@ -12,11 +51,16 @@ struct Image {
     }
   };
 
-  using Handle = std::unique_ptr<unsigned char, HandleDeleter>;
+  using Handle = std::shared_ptr<unsigned char>;
+  // STB is stb_image_write's encoder; FAST is encode::png, several times faster and no larger on icon art
+  enum class PngEncoder { STB, FAST };
+
   Handle data;
   int size   = 0; // raw size in bytes
   int pixels = 0; // pixel count
   int x = 0, y = 0, n = 0;
+  // non-destructive alpha for whoever shows the image (e.g. as the view's alpha); the pixels keep their own alpha
+  float displayAlpha = 1.0f;
 
   ~Image() = default;
 
@@ -30,15 +74,37 @@ struct Image {
 
   Image(unsigned char* img, int x, int y, int n);
   bool allocate();
+  // copies the pixels first if the buffer is shared with another Image
+  unsigned char* mutableData();
+  ImageView view() const { return { data.get(), x, y }; }
+  // detaches like mutableData()
+  MutableImageView mutableView() { return { mutableData(), x, y }; }
   Image(unsigned char* buffer, size_t size);
   Image(std::string file);
+  // file decoded straight to x by y; JPEGs and PNGs at least that large are scaled while decoding (see decode.hpp)
+  Image(const std::string& file, int x, int y);
   void resize(int x, int y);
   bool writeJpg(std::filesystem::path path);
-  bool writePng(std::filesystem::path path);
+  bool writePng(std::filesystem::path path, PngEncoder encoder = PngEncoder::STB);
+  bool encodePng(std::vector<unsigned char>& out, PngEncoder encoder = PngEncoder::STB);
+  bool encodeJpg(std::vector<unsigned char>& out, int quality = 90);
   void applyAlpha(float alpha);
 
   std::string hash();
 
   static void applyAlpha(Image& image, float alpha);
+  static void merge(Image& top, Image& bottom, Image& output);
   static void merge(Image& frame, Image& character, Image& background, Image& output);
+
+  // output keeps its own dimensions; false if either side has no pixels
+  static bool resize(ImageView source, MutableImageView output);
+  static bool writeJpg(ImageView image, std::filesystem::path path);
+  static bool writePng(ImageView image, std::filesystem::path path, PngEncoder encoder = PngEncoder::STB);
+  static bool encodePng(ImageView image, std::vector<unsigned char>& out, PngEncoder encoder = PngEncoder::STB);
+  static bool encodeJpg(ImageView image, std::vector<unsigned char>& out, int quality = 90);
+  static std::string hash(ImageView image);
+  static void applyAlpha(MutableImageView image, float alpha);
+  // assume all views are the same size; output may alias an input
+  static void merge(ImageView top, ImageView bottom, MutableImageView output);
+  static void merge(ImageView frame, ImageView character, ImageView background, MutableImageView output);
 };
\ No newline at end of file
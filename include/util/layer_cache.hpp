@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "util/image.hpp"
+
+// Process-wide LRU of decoded, already-resized layers keyed by path, mtime and size, so flipping between the same
+// frames or characters (in ImageState or a grid preview) only reads the SD card once. Bounded by a byte budget;
+// safe to use from any thread.
+class LayerCache {
+public:
+  struct Stats {
+    size_t hits      = 0;
+    size_t misses    = 0;
+    size_t evictions = 0;
+    size_t bytes     = 0;
+    size_t entries   = 0;
+  };
+
+  LayerCache(const LayerCache&) = delete;
+  LayerCache& operator=(const LayerCache&) = delete;
+  LayerCache(LayerCache&&)                 = delete;
+  LayerCache& operator=(LayerCache&&) = delete;
+
+  static LayerCache& instance()
+  {
+    static LayerCache cache;
+    return cache;
+  }
+
+  // path decoded and resized to size x size; the image is empty if the file could not be read
+  Image get(const std::string& path, int size = 256);
+
+  Stats stats();
+
+private:
+  LayerCache() = default;
+
+  struct Entry {
+    std::string key;
+    Image image;
+  };
+
+  std::mutex mutex;
+  // most recently used first
+  std::list<Entry> entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+  Stats counters;
+};
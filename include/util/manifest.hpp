@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Content hashes of every file entry of the last fully extracted archive, keyed by the entry's path inside the
+// archive. extract::extract consults it to write only new or changed entries and to delete the ones an update dropped.
+namespace manifest {
+enum class State { NEW, CHANGED, UNCHANGED };
+
+class Manifest {
+public:
+  explicit Manifest(std::filesystem::path file);
+
+  // a missing or unreadable manifest behaves as an empty one
+  bool load();
+  bool save() const;
+  // entries of the loaded manifest
+  size_t size() const;
+
+  // records the entry for the next manifest and tells how it compares to the previous one
+  State record(const std::string& name, uint64_t hash);
+
+  // entries of the previous manifest the current archive did not have
+  std::vector<std::string> removed() const;
+
+  static uint64_t hash(const void* data, size_t size);
+
+private:
+  std::filesystem::path file;
+  std::unordered_map<std::string, uint64_t> previous;
+  std::unordered_map<std::string, uint64_t> current;
+};
+}
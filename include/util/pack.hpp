@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Optional packed form of the icon cache: every part PNG is copied into a few large pack files under paths::PackPath,
+// each starting with an index of (category, subcategory, name, offset, length, width, height), and the loose files
+// are removed. Parts keep their paths under paths::IconCachePath; Image, thumbnails, LayerCache and the catalog look
+// them up here first, so packed and loose caches read the same. Safe to use from any thread.
+namespace pack {
+// packs the loose files of the extracted cache together with the packed parts current still reports, then removes the
+// loose files. The extract manifest stays valid: an update skips unchanged packed parts and writes the rest loose for
+// the next build. On failure the previous packs and the loose files are left as they were.
+bool build(const std::function<bool(const std::string&)>& current);
+
+// writes the packed parts current still reports back out as loose files, where no loose file replaces them; done before
+// clear() so the parts an update skipped survive the packs going away
+bool unpack(const std::function<bool(const std::string&)>& current);
+
+// removes every pack file, e.g. after a loose extraction made them stale
+void clear();
+
+// opens the pack files and reads their indexes; done on first use otherwise
+bool load();
+
+bool available();
+
+// changes whenever the set of pack files changes; 0 without packs
+int64_t stamp();
+
+// reads the packed PNG of a path under paths::IconCachePath
+bool read(const std::string& path, std::vector<unsigned char>& out);
+
+// whether a path under paths::IconCachePath is packed
+bool contains(const std::string& path);
+
+bool stat(const std::string& path, int64_t& mtime, uint64_t& size);
+
+// visits the path of every packed part
+void list(const std::function<void(const std::string&)>& visit);
+}
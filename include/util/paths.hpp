@@ -7,6 +7,10 @@ const std::string_view BaseAppPath = "sdmc:/avatars/nso-icon-tool/";
 
 const std::string_view IconCachePath  = "sdmc:/avatars/nso-icons-main/";
 const std::string_view CacheFilePath  = "sdmc:/avatars/nso-icon-tool/cache.json";
+const std::string_view IconIndexPath  = "sdmc:/avatars/nso-icon-tool/icon_index.bin";
+const std::string_view ManifestPath   = "sdmc:/avatars/nso-icon-tool/manifest.bin";
 const std::string_view LogFilePath    = "sdmc:/avatars/nso-icon-tool/log.log";
 const std::string_view CollectionPath = "sdmc:/avatars/nso-icon-tool/collection";
+const std::string_view ThumbnailPath  = "sdmc:/avatars/nso-icon-tool/thumbnails";
+const std::string_view PackPath       = "sdmc:/avatars/nso-icon-tool/pack";
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Recycles 256x256 RGBA buffers, together with the shared_ptr control blocks that own them, so composing into
+// ImageState's layers stays off the heap once warmed up. A buffer returns to the pool when the last Image sharing it
+// is destroyed; beyond Capacity idle buffers it is freed instead. Safe to use from any thread.
+class PixelPool {
+public:
+  static constexpr int Side          = 256;
+  static constexpr size_t BufferSize = Side * Side * 4;
+  static constexpr size_t Capacity   = 8;
+
+  PixelPool(const PixelPool&) = delete;
+  PixelPool& operator=(const PixelPool&) = delete;
+  PixelPool(PixelPool&&)                 = delete;
+  PixelPool& operator=(PixelPool&&) = delete;
+
+  static PixelPool& instance()
+  {
+    // never destroyed: pooled buffers may be released by statics (e.g. LayerCache) that outlive a local static
+    static auto* pool = new PixelPool();
+    return *pool;
+  }
+
+  // an uninitialized buffer of BufferSize bytes; empty if the allocation failed
+  std::shared_ptr<unsigned char> acquire();
+
+private:
+  PixelPool();
+
+  struct Release;
+  template <typename T> struct BlockAllocator;
+
+  void release(unsigned char* buffer);
+  void* allocateBlock(size_t size);
+  void releaseBlock(void* block, size_t size);
+
+  std::mutex mutex;
+  // reserved up front so returning a buffer or block never allocates
+  std::vector<unsigned char*> buffers;
+  std::vector<void*> blocks;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "state/image_state.hpp"
+
+// Composes the focus preview of a grid off the UI thread. Requests are debounced and coalesced so holding the D-pad
+// only composes the newest path; a result superseded while it was being composed is dropped, and show only ever runs
+// on the main thread for the latest request.
+class PreviewPipeline {
+public:
+  using Compose = std::function<void(std::string, ImageState&)>;
+  using Show    = std::function<void(const Image&)>;
+
+  // compose runs on the worker against a private copy of state; the caller's state is never touched
+  PreviewPipeline(const ImageState& state, Compose compose, Show show);
+  ~PreviewPipeline();
+
+  PreviewPipeline(const PreviewPipeline&) = delete;
+  PreviewPipeline& operator=(const PreviewPipeline&) = delete;
+
+  void request(const std::string& path);
+
+private:
+  void run(std::stop_token token);
+
+  ImageState state;
+  Compose compose;
+  Show show;
+
+  // bumped by every request and on destruction; results carry the value they were requested under
+  std::shared_ptr<std::atomic_uint64_t> generation = std::make_shared<std::atomic_uint64_t>(0);
+
+  std::mutex mutex;
+  std::condition_variable_any condition;
+  std::string pending;
+  bool hasPending = false;
+
+  // declared last so it is joined before anything it uses goes away
+  std::jthread worker;
+};
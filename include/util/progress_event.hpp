@@ -13,6 +13,7 @@ private:
   std::atomic<long> _status_code = 0;
   std::atomic<bool> _interupt    = false;
   std::atomic<double> _timeStep  = 0;
+  std::atomic_int _files         = 0;
 
 public:
   ProgressEvent(const ProgressEvent&) = delete;
@@ -36,6 +37,7 @@ public:
     _status_code = 0;
     _interupt    = false;
     _timeStep    = 0;
+    _files       = 0;
   }
 
   inline void setTotalSteps(int steps) { _max = steps; }
@@ -46,6 +48,8 @@ public:
   inline void setStatusCode(long status_code) { _status_code = status_code; }
   inline void incrementStep(int increment) { _current += increment; }
   inline void setNow(double now) { _now = now; }
+  inline void incrementFiles() { _files++; }
+  inline int getFiles() { return _files; }
   inline int getStep() { return _current; }
   inline double getNow() { return _now; }
   inline bool finished() { return (_current == _max); }
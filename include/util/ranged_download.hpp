@@ -0,0 +1,53 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The pieces of download::downloadResumable that talk HTTP and keep the resume state: a probe for range support,
+// parallel ranged fetches into a preallocated file, and output.state, which records how far each range got so a
+// dropped connection or a killed app picks up where it stopped. Nothing here touches the UI or libnx.
+namespace ranged {
+
+// one slice of a ranged download; done counts the bytes of [start, end] already on disk
+struct Range {
+  int64_t start         = 0;
+  int64_t end           = 0;
+  int64_t done          = 0;
+  FILE* file            = nullptr;
+  CURL* curl            = nullptr;
+  bool stale            = false; // the server answered with something other than this slice
+  const bool* cancelled = nullptr;
+};
+
+struct Probe {
+  std::string url; // after redirects, so the ranges skip them
+  std::string validator;
+  int64_t size = 0;
+};
+
+// asks for the first byte only: a 206 says the server takes ranges and carries the total size. A server that ignores
+// the range is cut off at its first body bytes, so the probe never pulls the whole file.
+bool probe(const std::string& url, Probe& res);
+
+std::string statePath(const std::string& output);
+void saveState(const std::string& output, const std::string& url, const Probe& info, const std::vector<Range>& ranges);
+// the ranges of an earlier partial download of the same content, or nothing if there is none to pick up
+std::vector<Range> loadState(const std::string& output, const std::string& url, const Probe& info);
+
+std::vector<Range> split(int64_t size, int connections);
+// output at its final size, so every range can write into its own slice
+bool createFile(const std::string& output, int64_t size);
+int64_t received(const std::vector<Range>& ranges);
+bool complete(const std::vector<Range>& ranges);
+
+// runs every unfinished range at once on a multi handle, saving the state about once a second so a killed app
+// resumes close to where it stopped. progress gets the total and received bytes; returning false cancels. false if the
+// server content no longer matches the partial file.
+bool fetch(const std::string& url, const std::string& output, const Probe& info, std::vector<Range>& ranges,
+    const std::function<bool(int64_t, int64_t)>& progress);
+}
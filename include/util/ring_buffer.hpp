@@ -0,0 +1,89 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Bounded single producer/single consumer byte pipe. write blocks while the buffer is full and read blocks while it is
+// empty; read returns 0 once the producer closed the pipe and everything was drained. abort wakes both sides and
+// makes every further call fail.
+class RingBuffer {
+public:
+  explicit RingBuffer(size_t capacity)
+      : buffer(capacity)
+  {
+  }
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  bool write(const void* data, size_t size)
+  {
+    auto* bytes = static_cast<const unsigned char*>(data);
+    std::unique_lock lock(mutex);
+
+    while (size > 0) {
+      writable.wait(lock, [this]() { return aborted || count < buffer.size(); });
+      if (aborted || closed)
+        return false;
+
+      auto tail  = (head + count) % buffer.size();
+      auto chunk = std::min({ size, buffer.size() - count, buffer.size() - tail });
+      std::memcpy(buffer.data() + tail, bytes, chunk);
+
+      count += chunk;
+      bytes += chunk;
+      size -= chunk;
+      readable.notify_one();
+    }
+    return true;
+  }
+
+  // bytes read, 0 at the end of the stream or -1 if the pipe was aborted
+  ssize_t read(void* data, size_t size)
+  {
+    std::unique_lock lock(mutex);
+    readable.wait(lock, [this]() { return aborted || closed || count > 0; });
+    if (aborted)
+      return -1;
+    if (count == 0)
+      return 0;
+
+    auto chunk = std::min({ size, count, buffer.size() - head });
+    std::memcpy(data, buffer.data() + head, chunk);
+
+    head = (head + chunk) % buffer.size();
+    count -= chunk;
+    writable.notify_one();
+    return static_cast<ssize_t>(chunk);
+  }
+
+  void close()
+  {
+    std::lock_guard lock(mutex);
+    closed = true;
+    readable.notify_all();
+  }
+
+  void abort()
+  {
+    std::lock_guard lock(mutex);
+    aborted = true;
+    readable.notify_all();
+    writable.notify_all();
+  }
+
+private:
+  std::vector<unsigned char> buffer;
+  size_t head  = 0;
+  size_t count = 0;
+  bool closed  = false;
+  bool aborted = false;
+  std::mutex mutex;
+  std::condition_variable readable;
+  std::condition_variable writable;
+};
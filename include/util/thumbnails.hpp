@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "util/image.hpp"
+
+// Downscaled copies of grid images, generated once and kept as PNGs in one container file per source directory
+// under paths::ThumbnailPath. An entry is regenerated when the source's mtime or size changes; every container is
+// discarded when the icon cache's updateSha changes. A container is rewritten once replaced or deleted entries take up
+// half of it.
+namespace thumbnails {
+constexpr int Size = 128;
+
+Image load(const std::string& path, int size = Size);
+void setStamp(const std::string& stamp);
+}
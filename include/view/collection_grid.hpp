@@ -4,6 +4,8 @@
 #include <borealis/core/event.hpp>
 
 #include "state/image_state.hpp"
+#include "util/decode_pool.hpp"
+#include "util/preview_pipeline.hpp"
 #include "view/recycling_grid.hpp"
 
 namespace collection {
@@ -24,31 +26,45 @@ public:
   {
     image->clear();
     img.clear();
+    loading = false;
+    ++*ticket;
   }
 
   virtual void cacheForReuse() override
   {
     image->clear();
     img.clear();
+    ++*ticket;
   }
 
   virtual void onFocusGained() override;
 
+  void draw(
+      NVGcontext* vg, float x, float y, float width, float height, brls::Style style, brls::FrameContext* ctx) override;
+
+  // decode path on the DecodePool and show it once ready, unless the cell was recycled in the meantime
+  void load(const std::string& path, size_t index, std::function<void(Image&&)> onLoaded = nullptr);
+
   static RecyclerCell* create(std::function<void(std::string)> cb);
   CollectionItem* ref;
   std::string img = "";
   std::function<void(std::string)> cb;
+  DecodePool::Ticket ticket = std::make_shared<std::atomic_uint64_t>(0);
+  bool loading              = false;
 };
 
 class DataSource : public RecyclingGridDataSource {
 public:
   DataSource(std::vector<CollectionItem> items, std::function<void(std::string)> onSelected, brls::View* parent);
+  ~DataSource() override;
   bool onItemAction(RecyclingGrid* recycler, size_t index, brls::ControllerButton button) override;
 
   RecyclingGridItem* cellForRow(RecyclingGrid* recycler, size_t index) override;
 
   void onItemSelected(RecyclingGrid* recycler, size_t index) override;
 
+  void prefetchRows(RecyclingGrid* recycler, const std::vector<size_t>& indexes) override;
+
   void clearData() override;
 
   size_t getItemCount() override;
@@ -60,6 +76,8 @@ public:
   std::function<void(std::string)> onSelected;
   std::vector<CollectionItem> items;
   brls::View* parent = nullptr;
+  // bumped when items are cleared or the source is destroyed, so decodes still in flight leave items alone
+  DecodePool::Ticket generation = std::make_shared<std::atomic_uint64_t>(0);
 };
 
 class CollectionGrid : public brls::Box {
@@ -70,6 +88,10 @@ public:
   BRLS_BIND(RecyclingGrid, recycler, "recycler");
   BRLS_BIND(brls::Image, workingImage, "image");
   BRLS_BIND(brls::Button, confirmDelete, "confirm_delete");
+
+private:
+  // composes the focused icon into the preview off the UI thread
+  std::unique_ptr<PreviewPipeline> preview;
 };
 
 }
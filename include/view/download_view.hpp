@@ -2,13 +2,21 @@
 
 #include <atomic>
 #include <borealis.hpp>
+#include <filesystem>
+#include <functional>
+
+namespace catalog {
+class Builder;
+}
 
 typedef brls::Event<std::string> DownloadDoneEvent;
 
+// An empty downloadPath streams the archive straight into extraction instead of saving it first; packIcons packs the
+// extracted icon cache afterwards (see pack.hpp)
 class DownloadView : public brls::Box {
 public:
   DownloadView(std::string url, std::string downloadPath, std::string extractPath, bool overwriteExisting,
-      DownloadDoneEvent::Callback cb);
+      bool packIcons, DownloadDoneEvent::Callback cb);
   ~DownloadView()
   {
     if (downloadThread.joinable())
@@ -30,7 +38,14 @@ private:
   BRLS_BIND(brls::Label, status_current, "status_current");
 
   void downloadFile();
+  void streamFile();
   void updateProgress();
+  void updateStreamProgress();
+  // the extract check that counts packed parts as present while packing is on
+  std::function<bool(const std::filesystem::path&)> packedExists();
+  // packs the cache and writes the index; false if the extraction was interrupted or the packed parts it skipped
+  // could not be kept
+  bool finishExtract(catalog::Builder& index);
 
   std::jthread updateThread;
   std::jthread downloadThread;
@@ -38,8 +53,11 @@ private:
   std::condition_variable threadCondition;
 
   DownloadDoneEvent::Callback cb;
+  // empty on success, otherwise the message handed to cb
+  std::string error;
 
   std::atomic_flag downloadFinished;
   std::atomic_flag extractFinished;
   bool overwriteExisting;
+  bool packIcons;
 };
\ No newline at end of file
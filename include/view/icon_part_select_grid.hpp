@@ -3,7 +3,12 @@
 #include <borealis.hpp>
 #include <borealis/core/event.hpp>
 
+#include <optional>
+
 #include "state/image_state.hpp"
+#include "util/context_preview.hpp"
+#include "util/decode_pool.hpp"
+#include "util/preview_pipeline.hpp"
 #include "view/recycling_grid.hpp"
 
 namespace grid {
@@ -20,19 +25,32 @@ public:
   {
     image->clear();
     img.clear();
+    loading = false;
+    ++*ticket;
   }
 
   virtual void cacheForReuse() override
   {
     image->clear();
     img.clear();
+    ++*ticket;
   }
 
   virtual void onFocusGained() override;
 
+  void draw(
+      NVGcontext* vg, float x, float y, float width, float height, brls::Style style, brls::FrameContext* ctx) override;
+
+  // decode path on the DecodePool (or compose it through context when set) and show it once ready, unless the cell
+  // was recycled in the meantime
+  void load(const std::string& path, size_t index, std::function<void(Image&&)> onLoaded = nullptr,
+      ContextPreview* context = nullptr);
+
   static RecyclerCell* create(std::function<void(std::string)> cb);
   std::string img = "";
   std::function<void(std::string)> cb;
+  DecodePool::Ticket ticket = std::make_shared<std::atomic_uint64_t>(0);
+  bool loading              = false;
 };
 
 class DataSource : public RecyclingGridDataSource {
@@ -43,6 +61,10 @@ public:
 
   void onItemSelected(RecyclingGrid* recycler, size_t index) override;
 
+  void prefetchRows(RecyclingGrid* recycler, const std::vector<size_t>& indexes) override;
+
+  void updateCell(RecyclingGridItem* item, size_t index) override;
+
   void clearData() override;
 
   size_t getItemCount() override;
@@ -50,16 +72,30 @@ public:
   std::function<void(std::string)> onSelected;
   std::vector<std::string> files;
   brls::View* parent = nullptr;
+  // set while the grid shows parts in context; owned by IconPartSelectGrid
+  ContextPreview* context = nullptr;
 };
 
 class IconPartSelectGrid : public brls::Box {
 public:
+  // with a layer, the grid offers a "preview in context" mode showing each part as the finished icon
   IconPartSelectGrid(const std::vector<std::string>& files, std::string title, ImageState& state,
-      std::function<void(std::string)> onSelected, std::function<void(std::string, ImageState& state)> onFocused);
+      std::function<void(std::string)> onSelected, std::function<void(std::string, ImageState& state)> onFocused,
+      std::optional<ImageState::Layer> layer = std::nullopt);
 
 private:
   BRLS_BIND(RecyclingGrid, recycler, "recycler");
   BRLS_BIND(brls::Image, workingImage, "image");
+
+  // composes the focused part into the preview off the UI thread
+  std::unique_ptr<PreviewPipeline> preview;
+
+  void toggleContext();
+
+  DataSource* data = nullptr;
+  ImageState contextState;
+  std::optional<ImageState::Layer> layer;
+  std::unique_ptr<ContextPreview> context;
 };
 
 }
\ No newline at end of file
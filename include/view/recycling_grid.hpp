@@ -14,6 +14,8 @@
 #include <borealis/views/scrolling_frame.hpp>
 #include <map>
 
+#include "util/fenwick_tree.hpp"
+
 namespace brls {
 class Label;
 class Image;
@@ -52,6 +54,8 @@ public:
   virtual void cacheForReuse() { }
 
 protected:
+  // RecyclingGrid 将 index 的地址作为 parentUserdata，避免为每个列表项单独分配内存
+  friend class RecyclingGrid;
   size_t index;
 };
 
@@ -82,6 +86,12 @@ public:
    */
   virtual void onItemSelected(RecyclingGrid* recycler, size_t index) { }
 
+  /*
+   * Asks the data source to warm what cellForRow will need for these rows (e.g. decoded images) off the main
+   * thread. Rows are ordered nearest first along the scroll direction; a later call supersedes earlier ones.
+   */
+  virtual void prefetchRows(RecyclingGrid* recycler, const std::vector<size_t>& indexes) { }
+
   virtual bool onItemAction(RecyclingGrid* recycler, size_t index, brls::ControllerButton button) { return false; }
 
   virtual void clearData() = 0;
@@ -134,6 +144,9 @@ public:
   //    计算从start元素的顶点到index（不包含index）元素顶点的距离
   float getHeightByCellIndex(size_t index, size_t start = 0);
 
+  /// 获取距离列表顶部 height 处的元素索引（瀑布流模式下为 O(log n)）
+  size_t getCellIndexByHeight(float height);
+
   View* getNextCellFocus(brls::FocusDirection direction, View* currentView);
 
   void forceRequestNextPage();
@@ -185,6 +198,9 @@ public:
   /// 预取的行数
   int preFetchLine = 1;
 
+  /// 沿滚动方向预解码图片的最大行数，实际行数随滚动速度增加（0 表示关闭）
+  int preDecodeLine = 2;
+
   /// 瀑布流模式，每一项高度不固定（仅在spanCount为1时可用）
   bool isFlowMode = false;
 
@@ -198,7 +214,32 @@ private:
   // 数据为空时不请求下一页，因为有些时候首页和下一页请求的内容或方式不同
   // 当列表元素有变动时（添加或修改数据源，会重置为false，这是将允许请求下一页）
 
+  // 只在滚动位置、布局或数据变化后执行 itemsRecyclingLoop，静止时不做任何回收计算
+  bool recyclingDirty      = true;
+  float lastContentOffsetY = 0;
+
+  // 回收耗时统计（debug 日志），用于观察静止时的开销
+  brls::Time recyclingTime    = 0;
+  size_t recyclingRuns        = 0;
+  size_t drawnFrames          = 0;
+  // 回收过程中的内存分配次数（仅在开启 COUNT_ALLOCATIONS 时统计），其中 sourceAllocations 来自 dataSource->cellForRow
+  size_t addedCells           = 0;
+  size_t recyclingAllocations = 0;
+  size_t sourceAllocations    = 0;
+
+  // 平滑后的滚动速度（像素/帧）与最近的滚动或焦点移动方向（1 向下，-1 向上），用于预解码
+  float scrollVelocity = 0;
+  int scrollDirection  = 1;
+  // 上一次请求预解码的范围 [prefetchStart, prefetchEnd)，范围不变时不重复请求
+  size_t prefetchStart = 0;
+  size_t prefetchEnd   = 0;
+
   uint32_t visibleMin, visibleMax;
+  // 当前显示的列表项（环形缓冲区），第 i 项为 visibleCells[(visibleHead + i) % size]，对应索引 visibleMin + i
+  // 列表项只会在两端添加或移除，容量足够后滚动时不再分配内存
+  std::vector<RecyclingGridItem*> visibleCells;
+  size_t visibleHead  = 0;
+  size_t visibleCount = 0;
   size_t defaultCellFocus = 0;
 
   float paddingTop    = 0;
@@ -217,6 +258,9 @@ private:
   // ButtonRefresh* refreshButton;
   brls::Rect renderedFrame;
   std::vector<float> cellHeightCache;
+  // 瀑布流模式下每项（含间距）高度的前缀和，以及第一个高度未知的元素
+  FenwickTree cellHeightIndex;
+  size_t firstUnknownHeight = 0;
   std::map<std::string, std::vector<RecyclingGridItem*>*> queueMap;
   std::map<std::string, std::function<RecyclingGridItem*(void)>> allocationMap;
 
@@ -226,8 +270,27 @@ private:
   // 回收列表项
   void queueReusableCell(RecyclingGridItem* cell);
 
+  // 获取当前显示的指定索引的列表项，O(1)；不在显示范围内时返回 nullptr
+  RecyclingGridItem* cellAt(size_t index);
+
+  // 在显示列表的头部或尾部添加、移除列表项
+  void pushVisibleCell(RecyclingGridItem* cell, bool front);
+  void popVisibleCell(bool front);
+
   void itemsRecyclingLoop();
 
+  // 请求 dataSource 预解码显示范围之外、沿 scrollDirection 方向的若干行
+  void prefetchAhead();
+
+  // 瀑布流模式下更新 cellHeightCache[index] 并同步前缀和
+  void setCellHeight(size_t index, float height);
+
+  // 回收所有显示中的列表项并从屏幕上移除
+  void clearVisibleCells();
+
+  // 回收所有显示中的列表项，以 index 所在行为起点重新开始渲染（瀑布流模式下不会越过第一个高度未知的元素）
+  void resetWindowAt(size_t index);
+
   /**
    * 在指定位置添加一个列表项
    * 内部更新 renderedFrame 的值，假设有一个每一项都绘制的超长列表，renderedFrame 的 y
@@ -255,6 +318,10 @@ public:
 
   static RecyclingGridItem* create();
 
+  // also used by cells that show a placeholder while their image loads
+  static void drawSkeleton(
+      NVGcontext* vg, float x, float y, float width, float height, NVGcolor background, float alpha);
+
   void draw(
       NVGcontext* vg, float x, float y, float width, float height, brls::Style style, brls::FrameContext* ctx) override;
 
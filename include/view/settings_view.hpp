@@ -8,6 +8,8 @@ enum class UpdateState { CHECK = 0, UPDATE };
 
 struct SettingsData {
   bool overwriteDuringExtract = false;
+  bool streamDuringDownload   = true;
+  bool packIconCache          = false;
 };
 
 class SettingsView : public brls::Box {
@@ -16,6 +18,8 @@ public:
 
   BRLS_BIND(brls::BooleanCell, debug, "debug");
   BRLS_BIND(brls::BooleanCell, extract_overwrite, "extract_overwrite");
+  BRLS_BIND(brls::BooleanCell, extract_stream, "extract_stream");
+  BRLS_BIND(brls::BooleanCell, extract_pack, "extract_pack");
   BRLS_BIND(brls::DetailCell, about, "about");
   BRLS_BIND(brls::Button, updateButton, "update_button");
   BRLS_BIND(brls::Label, updateText, "update_status");
@@ -27,6 +27,7 @@
 #include <string>
 
 #include "activity/main_activity.hpp"
+#include "util/catalog.hpp"
 #include "util/paths.hpp"
 #include "version.h"
 #include "view/main_view.hpp"
@@ -77,6 +78,9 @@ int main(int argc, char* argv[])
 
   brls::Application::createWindow("demo/title"_i18n);
 
+  if (!catalog::load())
+    brls::Logger::info("No usable icon index; it will be rebuilt on first use");
+
   brls::Application::getPlatform()->setThemeVariant(brls::ThemeVariant::DARK);
 
   // Have the application register an action on every activity that will quit when you press BUTTON_START
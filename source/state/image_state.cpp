@@ -1,5 +1,13 @@
 #include "state/image_state.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "util/layer_cache.hpp"
+
+constexpr size_t BatchWorkers = 3;
+
 Image empty(256, 256);
 
 ImageState::ImageState()
@@ -7,10 +15,78 @@ ImageState::ImageState()
     , character(256, 256)
     , background(256, 256)
     , working(256, 256)
+    , composite(256, 256)
+{
+}
+
+void ImageState::merge()
 {
+  if (dirty & (CHARACTER | BACKGROUND))
+    Image::merge(character, background, composite);
+
+  Image::merge(frame, composite, working);
+  dirty = 0;
 }
 
-void ImageState::merge() { Image::merge(frame, character, background, working); }
+std::vector<Image> ImageState::composeBatch(Layer layer, const std::vector<Image>& candidates, int size) const
+{
+  auto scaled = [size](const Image& image) {
+    Image res = image;
+    res.resize(size, size);
+    return res;
+  };
+
+  Image top = scaled(frame), middle = scaled(character), bottom = scaled(background);
+  if (layer == FRAME) {
+    // character and background never change within the batch; blend them once
+    Image pre(size, size);
+    Image::merge(middle, bottom, pre);
+    bottom = std::move(pre);
+  }
+
+  std::vector<Image> res(candidates.size());
+  std::atomic_size_t next = 0;
+
+  auto work = [&]() {
+    // candidates of another size are scaled into one buffer per worker instead of a new image each
+    Image scratch;
+    for (size_t i; (i = next++) < candidates.size();) {
+      if (!candidates[i].data)
+        continue;
+
+      auto candidate = candidates[i].view();
+      if (candidate.x != size || candidate.y != size) {
+        if (!scratch.data)
+          scratch = Image(size, size);
+        if (!Image::resize(candidate, scratch.mutableView()))
+          continue;
+        candidate = scratch.view();
+      }
+
+      Image output(size, size);
+      switch (layer) {
+      case FRAME:
+        Image::merge(candidate, bottom.view(), output.mutableView());
+        break;
+      case CHARACTER:
+        Image::merge(top.view(), candidate, bottom.view(), output.mutableView());
+        break;
+      case BACKGROUND:
+        Image::merge(top.view(), middle.view(), candidate, output.mutableView());
+        break;
+      }
+      res[i] = std::move(output);
+    }
+  };
+
+  {
+    std::vector<std::jthread> workers;
+    for (size_t i = 1; i < std::min(BatchWorkers, candidates.size()); i++)
+      workers.emplace_back(work);
+    work();
+  }
+  return res;
+}
 
 void ImageState::resize()
 {
@@ -22,27 +98,26 @@ void ImageState::resize()
 
 void ImageState::updateFrame(std::string path)
 {
-  frame = path.empty() ? empty : Image(path);
-  resize();
+  frame = path.empty() ? empty : LayerCache::instance().get(path, 256);
+  dirty |= FRAME;
   merge();
 }
 
 void ImageState::updateCharacter(std::string path)
 {
-  character = path.empty() ? empty : Image(path);
-  resize();
+  character = path.empty() ? empty : LayerCache::instance().get(path, 256);
+  dirty |= CHARACTER;
   merge();
 }
 
 void ImageState::updateBackground(std::string path)
 {
-  background = path.empty() ? empty : Image(path);
-  resize();
+  background = path.empty() ? empty : LayerCache::instance().get(path, 256);
+  dirty |= BACKGROUND;
   merge();
 }
 
 void ImageState::updateWorking(std::string path)
 {
-  working = path.empty() ? empty : Image(path);
-  resize();
-}
\ No newline at end of file
+  working = path.empty() ? empty : LayerCache::instance().get(path, 256);
+}
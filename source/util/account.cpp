@@ -2,15 +2,11 @@
 
 #include <switch.h>
 
-#include <filesystem>
-#include <fstream>
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "borealis.hpp"
-#include "util/paths.hpp"
-
-namespace fs = std::filesystem;
 
 namespace account {
 
@@ -61,8 +57,11 @@ Image getProfileImage(UserInfo& user)
 
 bool setUserIcon(UserInfo& user, Image& image)
 {
-  auto path = fs::path(paths::BaseAppPath) / "tmpicon.jpg";
-  image.writeJpg(path);
+  // encoded in memory and handed straight to the IPC; kept across calls so its capacity is reused
+  static std::vector<unsigned char> jpg;
+  jpg.clear();
+  if (!image.encodeJpg(jpg))
+    return false;
 
   auto* service = accountGetServiceSession();
   if (!service)
@@ -87,24 +86,16 @@ bool setUserIcon(UserInfo& user, Image& image)
   if (!R_SUCCEEDED(res))
     return false;
 
-  {
-    auto size   = fs::file_size(path);
-    auto buffer = std::make_unique<char[]>(size);
-    std::fstream stream(path, std::ios::in);
-    stream.read(buffer.get(), size);
-
-    res = serviceDispatchIn(&editor, 101, base,
-                              .buffer_attrs = {
-                                  SfBufferAttr_FixedSize | SfBufferAttr_In | SfBufferAttr_HipcPointer,
-                                  SfBufferAttr_HipcMapAlias | SfBufferAttr_In,
-                              },
-                              .buffers = {
-                                  {&data, sizeof(data)},
-                                  {(void *)buffer.get(), (size_t)size},
-                              });
-  }
-
-  fs::remove(path);
+  res = serviceDispatchIn(&editor, 101, base,
+                            .buffer_attrs = {
+                                SfBufferAttr_FixedSize | SfBufferAttr_In | SfBufferAttr_HipcPointer,
+                                SfBufferAttr_HipcMapAlias | SfBufferAttr_In,
+                            },
+                            .buffers = {
+                                {&data, sizeof(data)},
+                                {(void *)jpg.data(), jpg.size()},
+                            });
+
   return true;
 }
 }
\ No newline at end of file
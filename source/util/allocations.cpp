@@ -0,0 +1,36 @@
+#include "util/allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef COUNT_ALLOCATIONS
+
+namespace {
+std::atomic_size_t counter = 0;
+}
+
+// the array and nothrow forms forward to these, so they are counted as well
+void* operator new(size_t size)
+{
+  counter.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace allocations {
+size_t count() { return counter.load(std::memory_order_relaxed); }
+}
+
+#else
+
+namespace allocations {
+size_t count() { return 0; }
+}
+
+#endif
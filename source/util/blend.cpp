@@ -0,0 +1,149 @@
+#include "util/blend.hpp"
+
+#include <cstdint>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BLEND_NEON
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#define BLEND_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define BLEND_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace blend {
+
+namespace {
+  // exact floor(t / 255) for t <= 255 * 255
+  inline uint32_t div255(uint32_t t) { return (t + 1 + (t >> 8)) >> 8; }
+
+#if defined(BLEND_NEON)
+  inline uint8x8_t div255(uint16x8_t t)
+  {
+    return vshrn_n_u16(vaddq_u16(vaddq_u16(t, vdupq_n_u16(1)), vshrq_n_u16(t, 8)), 8);
+  }
+
+  inline uint8x16_t channel(uint8x16_t top, uint8x16_t bottom, uint8x16_t alpha, uint8x16_t inverse)
+  {
+    auto lo = vmlal_u8(vmull_u8(vget_low_u8(top), vget_low_u8(alpha)), vget_low_u8(bottom), vget_low_u8(inverse));
+    auto hi = vmlal_u8(vmull_u8(vget_high_u8(top), vget_high_u8(alpha)), vget_high_u8(bottom), vget_high_u8(inverse));
+    return vcombine_u8(div255(lo), div255(hi));
+  }
+
+  // 16 pixels; vld4 splits the channels so alpha needs no shuffling
+  inline void over16(const unsigned char* top, const unsigned char* bottom, unsigned char* output)
+  {
+    auto t       = vld4q_u8(top);
+    auto b       = vld4q_u8(bottom);
+    auto inverse = vmvnq_u8(t.val[3]);
+
+    uint8x16x4_t o;
+    o.val[0] = channel(t.val[0], b.val[0], t.val[3], inverse);
+    o.val[1] = channel(t.val[1], b.val[1], t.val[3], inverse);
+    o.val[2] = channel(t.val[2], b.val[2], t.val[3], inverse);
+    o.val[3] = vbslq_u8(vceqq_u8(t.val[3], vdupq_n_u8(0)), b.val[3], vdupq_n_u8(0xff));
+    vst4q_u8(output, o);
+  }
+#elif defined(BLEND_AVX2)
+  inline __m256i blend16(__m256i top, __m256i bottom)
+  {
+    auto alpha   = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(top, 0xff), 0xff);
+    auto inverse = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+    auto t       = _mm256_add_epi16(_mm256_mullo_epi16(top, alpha), _mm256_mullo_epi16(bottom, inverse));
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(t, _mm256_set1_epi16(1)), _mm256_srli_epi16(t, 8)), 8);
+  }
+
+  // 8 pixels
+  inline void over8(const unsigned char* top, const unsigned char* bottom, unsigned char* output)
+  {
+    auto zero  = _mm256_setzero_si256();
+    auto amask = _mm256_set1_epi32(static_cast<int>(0xff000000));
+    auto t     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(top));
+    auto b     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bottom));
+
+    auto rgb = _mm256_packus_epi16(blend16(_mm256_unpacklo_epi8(t, zero), _mm256_unpacklo_epi8(b, zero)),
+        blend16(_mm256_unpackhi_epi8(t, zero), _mm256_unpackhi_epi8(b, zero)));
+
+    auto clear = _mm256_cmpeq_epi32(_mm256_and_si256(t, amask), zero);
+    auto a
+        = _mm256_and_si256(_mm256_or_si256(_mm256_and_si256(clear, b), _mm256_andnot_si256(clear, amask)), amask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), _mm256_or_si256(_mm256_andnot_si256(amask, rgb), a));
+  }
+#elif defined(BLEND_SSE2)
+  inline __m128i blend8(__m128i top, __m128i bottom)
+  {
+    auto alpha   = _mm_shufflehi_epi16(_mm_shufflelo_epi16(top, 0xff), 0xff);
+    auto inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    auto t       = _mm_add_epi16(_mm_mullo_epi16(top, alpha), _mm_mullo_epi16(bottom, inverse));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_set1_epi16(1)), _mm_srli_epi16(t, 8)), 8);
+  }
+
+  // 4 pixels
+  inline void over4(const unsigned char* top, const unsigned char* bottom, unsigned char* output)
+  {
+    auto zero  = _mm_setzero_si128();
+    auto amask = _mm_set1_epi32(static_cast<int>(0xff000000));
+    auto t     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top));
+    auto b     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom));
+
+    auto rgb = _mm_packus_epi16(blend8(_mm_unpacklo_epi8(t, zero), _mm_unpacklo_epi8(b, zero)),
+        blend8(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi8(b, zero)));
+
+    auto clear = _mm_cmpeq_epi32(_mm_and_si128(t, amask), zero);
+    auto a     = _mm_and_si128(_mm_or_si128(_mm_and_si128(clear, b), _mm_andnot_si128(clear, amask)), amask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_or_si128(_mm_andnot_si128(amask, rgb), a));
+  }
+#endif
+}
+
+void overScalar(const unsigned char* top, const unsigned char* bottom, unsigned char* output, size_t pixels)
+{
+  for (size_t i = 0; i < pixels * 4; i += 4) {
+    uint32_t alpha = top[i + 3], inverse = 255 - alpha;
+    uint8_t a      = alpha == 0 ? bottom[i + 3] : 0xff;
+
+    output[i + 0] = static_cast<uint8_t>(div255(top[i + 0] * alpha + bottom[i + 0] * inverse));
+    output[i + 1] = static_cast<uint8_t>(div255(top[i + 1] * alpha + bottom[i + 1] * inverse));
+    output[i + 2] = static_cast<uint8_t>(div255(top[i + 2] * alpha + bottom[i + 2] * inverse));
+    output[i + 3] = a;
+  }
+}
+
+void over(const unsigned char* top, const unsigned char* bottom, unsigned char* output, size_t pixels)
+{
+  size_t i = 0;
+
+#if defined(BLEND_NEON)
+  for (; i + 16 <= pixels; i += 16)
+    over16(top + i * 4, bottom + i * 4, output + i * 4);
+#elif defined(BLEND_AVX2)
+  for (; i + 16 <= pixels; i += 16) {
+    over8(top + i * 4, bottom + i * 4, output + i * 4);
+    over8(top + i * 4 + 32, bottom + i * 4 + 32, output + i * 4 + 32);
+  }
+#elif defined(BLEND_SSE2)
+  for (; i + 8 <= pixels; i += 8) {
+    over4(top + i * 4, bottom + i * 4, output + i * 4);
+    over4(top + i * 4 + 16, bottom + i * 4 + 16, output + i * 4 + 16);
+  }
+#endif
+
+  overScalar(top + i * 4, bottom + i * 4, output + i * 4, pixels - i);
+}
+
+void scaleAlpha(unsigned char* pixels, size_t count, float alpha)
+{
+  if (alpha >= 1.0f)
+    return;
+
+  // 256 multiplies up front instead of a float conversion per pixel
+  uint8_t table[256];
+  for (uint32_t a = 0; a < 256; a++)
+    table[a] = static_cast<uint8_t>(static_cast<float>(a) * alpha);
+
+  for (size_t i = 3; i < count * 4; i += 4)
+    pixels[i] = table[pixels[i]];
+}
+}
@@ -0,0 +1,365 @@
+#include "util/catalog.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <borealis.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include "util/pack.hpp"
+#include "util/paths.hpp"
+
+namespace fs = std::filesystem;
+
+namespace catalog {
+
+namespace {
+  constexpr char Magic[4]                   = { 'N', 'S', 'O', 'I' };
+  constexpr uint32_t Version                = 1;
+  constexpr std::string_view Representative = "characters";
+
+  struct Subcategory {
+    std::string_view name;
+    std::vector<std::string_view> files;
+  };
+
+  struct Entry {
+    std::string_view name;
+    std::string_view icon;
+    std::vector<Subcategory> subcategories;
+  };
+
+  // the index file is read once into buffer; every view in table points into it
+  std::vector<char> buffer;
+  std::vector<Entry> table;
+  bool loaded            = false;
+  std::atomic_bool stale = false;
+
+  int64_t timeOf(const fs::path& path)
+  {
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    return ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+  }
+
+  // runs on the UI thread, so a directory that cannot be read is skipped instead of throwing
+  template <typename F> void forEach(const fs::path& directory, F visit)
+  {
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+      visit(*it);
+  }
+
+  // used to notice parts added/removed (or packed) behind the index's back: files only touch their subcategory
+  // directory's mtime, so every directory down to that level is stamped, summed so iteration order does not matter
+  int64_t cacheStamp()
+  {
+    uint64_t res = timeOf(paths::IconCachePath);
+    forEach(fs::path(paths::IconCachePath), [&res](const fs::directory_entry& category) {
+      std::error_code ec;
+      if (!category.is_directory(ec))
+        return;
+      res += timeOf(category.path());
+      forEach(category.path(), [&res](const fs::directory_entry& subcategory) {
+        std::error_code ec;
+        if (subcategory.is_directory(ec))
+          res += timeOf(subcategory.path());
+      });
+    });
+    return static_cast<int64_t>(res) ^ pack::stamp();
+  }
+
+  class Reader {
+  public:
+    Reader(const std::vector<char>& data)
+        : pos(data.data())
+        , end(data.data() + data.size())
+    {
+    }
+
+    template <typename T> T read()
+    {
+      T value {};
+      if (static_cast<size_t>(end - pos) < sizeof(T)) {
+        ok = false;
+        return value;
+      }
+      std::memcpy(&value, pos, sizeof(T));
+      pos += sizeof(T);
+      return value;
+    }
+
+    std::string_view string()
+    {
+      auto length = read<uint16_t>();
+      if (!ok || static_cast<size_t>(end - pos) < length) {
+        ok = false;
+        return {};
+      }
+      std::string_view res(pos, length);
+      pos += length;
+      return res;
+    }
+
+    bool ok = true;
+
+  private:
+    const char* pos;
+    const char* end;
+  };
+
+  class Writer {
+  public:
+    Writer(std::vector<char>& data)
+        : data(data)
+    {
+    }
+
+    template <typename T> void write(T value)
+    {
+      auto* bytes = reinterpret_cast<const char*>(&value);
+      data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void string(std::string_view value)
+    {
+      write(static_cast<uint16_t>(value.size()));
+      data.insert(data.end(), value.begin(), value.end());
+    }
+
+  private:
+    std::vector<char>& data;
+  };
+
+  // fills table from buffer; every view points into it
+  bool parse()
+  {
+    table.clear();
+    loaded = false;
+
+    if (buffer.size() < sizeof(Magic) || std::memcmp(buffer.data(), Magic, sizeof(Magic)) != 0)
+      return false;
+
+    Reader reader(buffer);
+    reader.read<uint32_t>(); // magic, checked above
+    if (reader.read<uint32_t>() != Version || reader.read<int64_t>() != cacheStamp())
+      return false;
+
+    auto count = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < count && reader.ok; i++) {
+      auto& entry = table.emplace_back();
+      entry.name  = reader.string();
+      entry.icon  = reader.string();
+
+      auto subcategories = reader.read<uint32_t>();
+      for (uint32_t j = 0; j < subcategories && reader.ok; j++) {
+        auto& subcategory = entry.subcategories.emplace_back();
+        subcategory.name  = reader.string();
+
+        auto files = reader.read<uint32_t>();
+        for (uint32_t k = 0; k < files && reader.ok; k++)
+          subcategory.files.push_back(reader.string());
+      }
+    }
+
+    if (!reader.ok) {
+      table.clear();
+      return false;
+    }
+
+    loaded = true;
+    return true;
+  }
+
+  void scan(Builder& builder)
+  {
+    pack::list([&builder](const std::string& file) { builder.add(file); });
+
+    forEach(fs::path(paths::IconCachePath), [&builder](const fs::directory_entry& category) {
+      std::error_code ec;
+      if (!category.is_directory(ec))
+        return;
+      forEach(category.path(), [&builder](const fs::directory_entry& subcategory) {
+        std::error_code ec;
+        if (!subcategory.is_directory(ec))
+          return;
+        forEach(subcategory.path(), [&builder](const fs::directory_entry& file) {
+          std::error_code ec;
+          if (file.is_regular_file(ec))
+            builder.add(file.path());
+        });
+      });
+    });
+  }
+
+  void ensure()
+  {
+    if (loaded && !stale)
+      return;
+
+    if (load())
+      return;
+
+    brls::Logger::info("Icon index missing or stale; scanning {}", paths::IconCachePath);
+    Builder builder;
+    scan(builder);
+    if (builder.write() && load())
+      return;
+
+    // the index could not be written (or read back); keep the scanned entries in memory instead
+    brls::Logger::warning("Icon index could not be written; using the scan for this session");
+    buffer = builder.serialize();
+    parse();
+    loaded = true;
+    stale  = false;
+  }
+}
+
+void Builder::add(const fs::path& file)
+{
+  if (file.extension() != ".png")
+    return;
+
+  auto relative = file.lexically_relative(paths::IconCachePath);
+  std::vector<std::string> parts(relative.begin(), relative.end());
+  if (parts.size() != 3 || parts[0] == "..")
+    return;
+
+  entries[parts[0]][parts[1]].push_back(parts[2]);
+}
+
+bool Builder::contains(const fs::path& file) const
+{
+  auto relative = file.lexically_relative(paths::IconCachePath);
+  std::vector<std::string> parts(relative.begin(), relative.end());
+  if (parts.size() != 3)
+    return false;
+
+  auto category = entries.find(parts[0]);
+  if (category == entries.end())
+    return false;
+  auto subcategory = category->second.find(parts[1]);
+  return subcategory != category->second.end()
+      && std::find(subcategory->second.begin(), subcategory->second.end(), parts[2]) != subcategory->second.end();
+}
+
+std::vector<char> Builder::serialize()
+{
+  std::vector<char> data(Magic, Magic + sizeof(Magic));
+  Writer writer(data);
+  writer.write(Version);
+  writer.write(cacheStamp());
+  writer.write(static_cast<uint32_t>(entries.size()));
+
+  for (auto& [category, subcategories] : entries) {
+    std::string icon;
+    if (auto it = subcategories.find(std::string(Representative)); it != subcategories.end() && !it->second.empty())
+      icon = *std::min_element(it->second.begin(), it->second.end());
+
+    writer.string(category);
+    writer.string(icon);
+    writer.write(static_cast<uint32_t>(subcategories.size()));
+
+    for (auto& [subcategory, files] : subcategories) {
+      std::sort(files.begin(), files.end());
+      writer.string(subcategory);
+      writer.write(static_cast<uint32_t>(files.size()));
+      for (auto& file : files)
+        writer.string(file);
+    }
+  }
+  return data;
+}
+
+bool Builder::write()
+{
+  auto path = fs::path(paths::IconIndexPath);
+  auto temp = fs::path(path).replace_extension(".tmp");
+  auto data = serialize();
+
+  {
+    std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open() || !stream.write(data.data(), data.size()))
+      return false;
+  }
+
+  // rename does not replace an existing file on the Switch's fsdev
+  std::error_code ec;
+  fs::remove(path, ec);
+  fs::rename(temp, path, ec);
+  if (ec)
+    return false;
+
+  brls::sync([count = entries.size()]() { brls::Logger::info("Icon index written: {} categories", count); });
+  invalidate();
+  return true;
+}
+
+bool load()
+{
+  stale = false;
+  buffer.clear();
+  table.clear();
+  loaded = false;
+
+  std::ifstream stream(std::string(paths::IconIndexPath), std::ios::binary | std::ios::ate);
+  if (!stream.is_open())
+    return false;
+
+  auto size = static_cast<std::streamoff>(stream.tellg());
+  if (size <= 0)
+    return false;
+
+  buffer.resize(size);
+  stream.seekg(0);
+  if (!stream.read(buffer.data(), buffer.size()) || !parse())
+    return false;
+
+  brls::Logger::info("Loaded icon index {} ({} categories)", paths::IconIndexPath, table.size());
+  return true;
+}
+
+void invalidate() { stale = true; }
+
+std::vector<Category> categories(std::string_view subcategory)
+{
+  ensure();
+
+  std::vector<Category> res;
+  for (auto& entry : table) {
+    if (entry.icon.empty())
+      continue;
+
+    auto it = std::find_if(entry.subcategories.begin(), entry.subcategories.end(),
+        [subcategory](const Subcategory& sub) { return sub.name == subcategory; });
+    if (it == entry.subcategories.end() || it->files.empty())
+      continue;
+
+    auto icon = fs::path(paths::IconCachePath) / entry.name / Representative / entry.icon;
+    res.push_back(Category { std::string(entry.name), icon.string() });
+  }
+  return res;
+}
+
+std::vector<std::string> parts(std::string_view category, std::string_view subcategory)
+{
+  ensure();
+
+  std::vector<std::string> res;
+  auto entry = std::find_if(table.begin(), table.end(), [category](const Entry& e) { return e.name == category; });
+  if (entry == table.end())
+    return res;
+
+  for (auto& sub : entry->subcategories) {
+    if (sub.name != subcategory)
+      continue;
+
+    auto base = fs::path(paths::IconCachePath) / category / subcategory;
+    res.reserve(sub.files.size());
+    for (auto& file : sub.files)
+      res.push_back((base / file).string());
+  }
+  return res;
+}
+}
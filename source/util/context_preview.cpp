@@ -0,0 +1,67 @@
+#include "util/context_preview.hpp"
+
+#include <borealis.hpp>
+#include <chrono>
+#include <memory>
+
+#include "util/thumbnails.hpp"
+
+// how long the worker waits for the rest of a frame's requests before composing
+constexpr auto BatchWindow = std::chrono::milliseconds(8);
+
+ContextPreview::ContextPreview(const ImageState& state, ImageState::Layer layer)
+    : state(state)
+    , layer(layer)
+    , worker([this](std::stop_token token) { run(token); })
+{
+}
+
+ContextPreview::~ContextPreview()
+{
+  worker.request_stop();
+  worker.join();
+
+  // every callback has to run exactly once
+  for (auto& request : requests)
+    brls::sync([done = std::move(request.done)]() { done(Image()); });
+}
+
+void ContextPreview::request(const std::string& path, Callback done)
+{
+  {
+    std::lock_guard lock(mutex);
+    requests.push_back(Request { path, std::move(done) });
+  }
+  condition.notify_one();
+}
+
+void ContextPreview::run(std::stop_token token)
+{
+  while (!token.stop_requested()) {
+    std::vector<Request> batch;
+    {
+      std::unique_lock lock(mutex);
+      if (!condition.wait(lock, token, [this]() { return !requests.empty(); }))
+        return;
+
+      // cells of a page are requested back to back from cellForRow; let them all arrive
+      condition.wait_for(lock, token, BatchWindow, []() { return false; });
+      if (token.stop_requested())
+        return;
+      batch.swap(requests);
+    }
+
+    std::vector<Image> parts;
+    parts.reserve(batch.size());
+    for (auto& request : batch)
+      parts.push_back(thumbnails::load(request.path, thumbnails::Size));
+
+    // shared so the sync queue never copies the pixels
+    auto composed = std::make_shared<std::vector<Image>>(state.composeBatch(layer, parts, thumbnails::Size));
+    auto pending  = std::make_shared<std::vector<Request>>(std::move(batch));
+    brls::sync([pending, composed]() {
+      for (size_t i = 0; i < pending->size(); i++)
+        (*pending)[i].done(std::move((*composed)[i]));
+    });
+  }
+}
@@ -0,0 +1,57 @@
+#include "util/curl_pool.hpp"
+
+CurlPool::CurlPool()
+{
+  share = curl_share_init();
+  curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+  curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+  curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+CurlPool::~CurlPool()
+{
+  for (auto* curl : idle)
+    curl_easy_cleanup(curl);
+  curl_share_cleanup(share);
+}
+
+CURL* CurlPool::acquire()
+{
+  CURL* curl = nullptr;
+  {
+    std::lock_guard lock(mutex);
+    if (!idle.empty()) {
+      curl = idle.back();
+      idle.pop_back();
+    }
+  }
+
+  if (!curl)
+    curl = curl_easy_init();
+  if (curl)
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+  return curl;
+}
+
+void CurlPool::release(CURL* curl)
+{
+  if (!curl)
+    return;
+
+  curl_easy_reset(curl);
+  std::lock_guard lock(mutex);
+  idle.push_back(curl);
+}
+
+// requests run on the main thread and the download thread at the same time
+void CurlPool::lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr)
+{
+  static_cast<CurlPool*>(userptr)->locks[data].lock();
+}
+
+void CurlPool::unlockShare(CURL*, curl_lock_data data, void* userptr)
+{
+  static_cast<CurlPool*>(userptr)->locks[data].unlock();
+}
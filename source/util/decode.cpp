@@ -0,0 +1,225 @@
+#include "util/decode.hpp"
+
+#include <cstdio>
+// jpeglib.h uses FILE and size_t without declaring them
+#include <jpeglib.h>
+#include <png.h>
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace decode {
+
+namespace {
+  using File = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+  // a same-size source is left to the full decode, which keeps stb's exact pixels (and so existing collection hashes)
+  bool larger(int width, int height, int x, int y) { return width >= x && height >= y && (width > x || height > y); }
+
+  // Box filter fed one source row at a time: every source pixel lands in exactly one output pixel. Colours are
+  // weighted by alpha so transparent pixels do not darken the edges; a fully transparent output pixel keeps the plain
+  // average, as the full decode and resize would. Needs a source at least as large as the output.
+  class RowScaler {
+  public:
+    RowScaler(int width, int height, MutableImageView output)
+        : height(height)
+        , output(output)
+        , columns(width)
+        , columnCounts(output.x)
+        , sums(static_cast<size_t>(output.x) * Sums)
+    {
+      for (int x = 0; x < width; x++) {
+        columns[x] = static_cast<int>(static_cast<int64_t>(x) * output.x / width);
+        columnCounts[columns[x]]++;
+      }
+    }
+
+    void push(const unsigned char* row)
+    {
+      auto target = static_cast<int>(static_cast<int64_t>(y) * output.y / height);
+      if (target != outputRow)
+        flush();
+      outputRow = target;
+
+      for (size_t x = 0; x < columns.size(); x++) {
+        auto* pixel = row + x * 4;
+        auto* sum   = &sums[columns[x] * Sums];
+        sum[0] += pixel[0] * pixel[3];
+        sum[1] += pixel[1] * pixel[3];
+        sum[2] += pixel[2] * pixel[3];
+        sum[3] += pixel[3];
+        sum[4] += pixel[0];
+        sum[5] += pixel[1];
+        sum[6] += pixel[2];
+      }
+      rows++;
+
+      if (++y == height)
+        flush();
+    }
+
+  private:
+    // r*a, g*a, b*a, a, r, g, b
+    static constexpr size_t Sums = 7;
+
+    void flush()
+    {
+      if (!rows)
+        return;
+
+      auto* out = output.data + static_cast<size_t>(outputRow) * output.x * 4;
+      for (int x = 0; x < output.x; x++, out += 4) {
+        auto* sum  = &sums[x * Sums];
+        uint64_t n = static_cast<uint64_t>(rows) * columnCounts[x];
+        uint64_t a = sum[3];
+        for (int c = 0; c < 3; c++)
+          out[c] = static_cast<unsigned char>(a ? (sum[c] + a / 2) / a : (sum[c + 4] + n / 2) / n);
+        out[3] = static_cast<unsigned char>((a + n / 2) / n);
+      }
+      std::fill(sums.begin(), sums.end(), 0);
+      rows = 0;
+    }
+
+    int height;
+    MutableImageView output;
+    std::vector<int> columns; // output column of each source column
+    std::vector<uint32_t> columnCounts;
+    std::vector<uint64_t> sums; // Sums per output pixel of the current output row
+    int y         = 0;
+    int outputRow = 0;
+    int rows      = 0;
+  };
+
+  struct JpegError {
+    jpeg_error_mgr manager;
+    std::jmp_buf jump;
+  };
+
+  // libjpeg's default handler exits the process
+  void jpegErrorExit(j_common_ptr info) { std::longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1); }
+
+  void jpegMessage(j_common_ptr) { }
+
+  bool jpeg(std::FILE* file, int x, int y, const Target& target)
+  {
+    jpeg_decompress_struct info;
+    JpegError error;
+    std::vector<unsigned char> row;
+    std::unique_ptr<RowScaler> scaler;
+    MutableImageView output;
+
+    info.err                     = jpeg_std_error(&error.manager);
+    error.manager.error_exit     = jpegErrorExit;
+    error.manager.output_message = jpegMessage;
+    if (setjmp(error.jump)) {
+      jpeg_destroy_decompress(&info);
+      return false;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+    if (!larger(info.image_width, info.image_height, x, y)) {
+      jpeg_destroy_decompress(&info);
+      return false;
+    }
+
+    // the largest DCT reduction that still covers the output
+    info.out_color_space = JCS_EXT_RGBA;
+    info.scale_denom     = 8;
+    for (info.scale_num = 1; info.scale_num < 8; info.scale_num++) {
+      jpeg_calc_output_dimensions(&info);
+      if (static_cast<int>(info.output_width) >= x && static_cast<int>(info.output_height) >= y)
+        break;
+    }
+    jpeg_calc_output_dimensions(&info);
+    if (static_cast<int>(info.output_width) < x || static_cast<int>(info.output_height) < y || !(output = target())) {
+      jpeg_destroy_decompress(&info);
+      return false;
+    }
+
+    jpeg_start_decompress(&info);
+    row.resize(static_cast<size_t>(info.output_width) * 4);
+    scaler = std::make_unique<RowScaler>(info.output_width, info.output_height, output);
+    while (info.output_scanline < info.output_height) {
+      auto* rows = row.data();
+      jpeg_read_scanlines(&info, &rows, 1);
+      scaler->push(row.data());
+    }
+
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return true;
+  }
+
+  bool png(std::FILE* file, int x, int y, const Target& target)
+  {
+    auto* read = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    if (!read)
+      return false;
+    auto* info = png_create_info_struct(read);
+    std::vector<unsigned char> row;
+    std::unique_ptr<RowScaler> scaler;
+    MutableImageView output;
+
+    if (!info || setjmp(png_jmpbuf(read))) {
+      png_destroy_read_struct(&read, info ? &info : nullptr, nullptr);
+      return false;
+    }
+
+    png_init_io(read, file);
+    png_read_info(read, info);
+
+    auto width  = static_cast<int>(png_get_image_width(read, info));
+    auto height = static_cast<int>(png_get_image_height(read, info));
+    // interlaced rows only come out complete after the last pass
+    if (!larger(width, height, x, y) || png_get_interlace_type(read, info) != PNG_INTERLACE_NONE) {
+      png_destroy_read_struct(&read, &info, nullptr);
+      return false;
+    }
+
+    // everything to 8 bit RGBA
+    png_set_expand(read);
+    png_set_strip_16(read);
+    png_set_gray_to_rgb(read);
+    png_set_add_alpha(read, 0xff, PNG_FILLER_AFTER);
+    png_read_update_info(read, info);
+
+    row.resize(png_get_rowbytes(read, info));
+    if (row.size() != static_cast<size_t>(width) * 4 || !(output = target())) {
+      png_destroy_read_struct(&read, &info, nullptr);
+      return false;
+    }
+
+    scaler = std::make_unique<RowScaler>(width, height, output);
+    for (int i = 0; i < height; i++) {
+      png_read_row(read, row.data(), nullptr);
+      scaler->push(row.data());
+    }
+
+    png_destroy_read_struct(&read, &info, nullptr);
+    return true;
+  }
+}
+
+bool scaled(const std::string& path, int x, int y, const Target& target)
+{
+  if (x <= 0 || y <= 0)
+    return false;
+
+  File file(std::fopen(path.c_str(), "rb"), &std::fclose);
+  unsigned char magic[8];
+  if (!file || std::fread(magic, 1, sizeof(magic), file.get()) != sizeof(magic))
+    return false;
+  std::rewind(file.get());
+
+  if (magic[0] == 0xff && magic[1] == 0xd8 && magic[2] == 0xff)
+    return jpeg(file.get(), x, y, target);
+  if (png_sig_cmp(magic, 0, sizeof(magic)) == 0)
+    return png(file.get(), x, y, target);
+  return false;
+}
+}
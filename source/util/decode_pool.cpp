@@ -0,0 +1,93 @@
+#include "util/decode_pool.hpp"
+
+#include <algorithm>
+#include <borealis.hpp>
+
+#include "util/thumbnails.hpp"
+
+constexpr int DecodeWorkers       = 2;
+constexpr size_t PrefetchCapacity = 64;
+
+DecodePool::DecodePool()
+{
+  for (int i = 0; i < DecodeWorkers; i++)
+    workers.emplace_back([this](std::stop_token token) { run(token); });
+}
+
+void DecodePool::request(const std::string& path, const Ticket& ticket, Callback done, int thumbnail)
+{
+  {
+    std::lock_guard lock(mutex);
+    auto it = std::find_if(prefetched.begin(), prefetched.end(),
+        [&](const Prefetched& entry) { return entry.path == path && entry.thumbnail == thumbnail; });
+    if (it != prefetched.end()) {
+      // already decoded ahead of time; still delivered through brls::sync like any other result
+      auto result = std::make_shared<Image>(std::move(it->image));
+      prefetched.erase(it);
+      brls::sync([done = std::move(done), result]() { done(std::move(*result)); });
+      return;
+    }
+    jobs.push_back(Job { path, ticket, ticket->load(), std::move(done), thumbnail });
+  }
+  condition.notify_one();
+}
+
+void DecodePool::prefetch(std::vector<std::string> paths, int thumbnail)
+{
+  {
+    std::lock_guard lock(mutex);
+    prefetches.assign(std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()));
+    prefetchThumbnail = thumbnail;
+  }
+  condition.notify_all();
+}
+
+void DecodePool::warm(const std::string& path, int thumbnail)
+{
+  Image image = thumbnail ? thumbnails::load(path, thumbnail) : Image(path);
+  if (!image.data)
+    return;
+
+  std::lock_guard lock(mutex);
+  prefetched.push_back(Prefetched { path, thumbnail, std::move(image) });
+  while (prefetched.size() > PrefetchCapacity)
+    prefetched.pop_front();
+}
+
+void DecodePool::run(std::stop_token token)
+{
+  while (!token.stop_requested()) {
+    Job job;
+    {
+      std::unique_lock lock(mutex);
+      if (!condition.wait(lock, token, [this]() { return !jobs.empty() || !prefetches.empty(); }))
+        return;
+
+      // prefetches only run while nothing on screen is waiting
+      if (jobs.empty()) {
+        auto path      = std::move(prefetches.front());
+        auto thumbnail = prefetchThumbnail;
+        prefetches.pop_front();
+
+        bool cached = std::any_of(prefetched.begin(), prefetched.end(),
+            [&](const Prefetched& entry) { return entry.path == path && entry.thumbnail == thumbnail; });
+        lock.unlock();
+        if (!cached)
+          warm(path, thumbnail);
+        continue;
+      }
+
+      // newest first; while scrolling the most recent requests are the ones still on screen
+      job = std::move(jobs.back());
+      jobs.pop_back();
+    }
+
+    Image image;
+    if (*job.ticket == job.generation)
+      image = job.thumbnail ? thumbnails::load(job.path, job.thumbnail) : Image(job.path);
+
+    // shared so the sync queue never copies the pixels
+    auto result = std::make_shared<Image>(std::move(image));
+    brls::sync([done = std::move(job.done), result]() { done(std::move(*result)); });
+  }
+}
@@ -9,23 +9,37 @@
 #include <algorithm>
 #include <borealis.hpp>
 #include <chrono>
+#include <filesystem>
 #include <regex>
 #include <string>
 #include <thread>
 
+#include "util/curl_pool.hpp"
 #include "util/progress_event.hpp"
+#include "util/ranged_download.hpp"
+#include "util/ring_buffer.hpp"
 
 using namespace brls::literals; // for _i18n
 
 constexpr const char API_AGENT[] = "nso-icons";
 constexpr int _1MiB              = 0x100000;
 
-using json = nlohmann::ordered_json;
+using json   = nlohmann::ordered_json;
+namespace fs = std::filesystem;
 
 namespace download {
 
 namespace {
 
+  using Handle = CurlPool::Handle;
+
+  // the storage check runs on the first progress callback that knows the size, instead of a separate HEAD request
+  struct Transfer {
+    double factor     = 0; // free space needed relative to the download size; 0 skips the check
+    bool report       = true;
+    bool insufficient = false;
+  };
+
   std::chrono::_V2::steady_clock::time_point time_old;
   double dlold;
 
@@ -65,9 +79,14 @@ namespace {
     return realsize;
   }
 
-  int download_progress(void* p, double dltotal, double dlnow, double ultotal, double ulnow)
+  bool hasSpace(double required)
   {
+    s64 freeStorage;
+    return !R_SUCCEEDED(nsGetFreeSpaceSize(NcmStorageId_SdCard, &freeStorage)) || required <= freeStorage;
+  }
 
+  void report(double dltotal, double dlnow)
+  {
     if (dltotal <= 0.0) {
       // chunk download
       int counter = (int)(0 * ProgressEvent::instance().getMax()); // 20 is the number of increments
@@ -90,7 +109,21 @@ namespace {
       dlold    = dlnow;
       time_old = time_now;
     }
+  }
+
+  int download_progress(void* p, double dltotal, double dlnow, double ultotal, double ulnow)
+  {
+    auto* transfer = static_cast<Transfer*>(p);
+    if (transfer->factor > 0 && dltotal > 0) {
+      if (!hasSpace(dltotal * transfer->factor)) {
+        transfer->insufficient = true;
+        return 1;
+      }
+      transfer->factor = 0;
+    }
 
+    if (transfer->report)
+      report(dltotal, dlnow);
     return 0;
   }
 
@@ -118,26 +151,24 @@ namespace {
     return realsize;
   }
 
-  bool checkSize(CURL* curl, const std::string& url)
+  static size_t WriteStreamCallback(void* contents, size_t size, size_t num_files, void* userp)
   {
-    curl_off_t dl;
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, API_AGENT);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
-    curl_easy_perform(curl);
-    auto res = curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &dl);
-    if (!res) {
-      s64 freeStorage;
-      if (R_SUCCEEDED(nsGetFreeSpaceSize(NcmStorageId_SdCard, &freeStorage)) && dl * 2.5 > freeStorage) {
-        return false;
-      }
-      return true;
+    if (ProgressEvent::instance().getInterupt()) {
+      return 0;
     }
-    return true;
+    auto* pipe      = static_cast<RingBuffer*>(userp);
+    size_t realsize = size * num_files;
+    return pipe->write(contents, realsize) ? realsize : 0;
   }
+
+  void insufficientStorage()
+  {
+    brls::Application::crash("app/errors/insufficient_storage"_i18n);
+    std::this_thread::sleep_for(std::chrono::microseconds(2000000));
+    brls::Application::quit();
+  }
+
+  constexpr int RangeAttempts = 3;
 } // namespace
 
 long downloadFile(const std::string& url, const std::string& output, int api)
@@ -149,13 +180,12 @@ long downloadFile(const std::string& url, const std::string& output, int api)
 long downloadFile(const std::string& url, std::vector<std::uint8_t>& res, const std::string& output, int api)
 {
   const char* out      = output.c_str();
-  CURL* curl           = curl_easy_init();
+  Handle curl;
   ntwrk_struct_t chunk = { 0 };
-  long status_code;
+  Transfer transfer;
+  long status_code     = 0;
   time_old             = std::chrono::steady_clock::now();
   dlold                = 0.0f;
-  bool can_download    = true;
-  bool is_mega         = false;
   std::string real_url = url;
 
   if (curl) {
@@ -165,42 +195,35 @@ long downloadFile(const std::string& url, std::vector<std::uint8_t>& res, const
       chunk.data_size = _1MiB;
       chunk.out       = fp;
 
-      if (*out != 0) {
-        can_download = checkSize(curl, url);
-      }
-
-      if (can_download) {
-        curl_easy_setopt(curl, CURLOPT_URL, real_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, API_AGENT);
-        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-        curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk);
-        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, nullptr);
-
-        if (api == OFF) {
-          curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-          curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, download_progress);
-        }
-        curl_easy_perform(curl);
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
-
-        if (fp && chunk.offset && can_download)
-          fwrite(chunk.data, 1, chunk.offset, fp);
-
-        curl_easy_cleanup(curl);
-        ProgressEvent::instance().setStep(ProgressEvent::instance().getMax());
-      }
+      if (*out != 0)
+        transfer.factor = 2.5;
+      transfer.report = api == OFF;
+
+      curl_easy_setopt(curl, CURLOPT_URL, real_url.c_str());
+      curl_easy_setopt(curl, CURLOPT_USERAGENT, API_AGENT);
+      curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+      curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk);
+      curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, nullptr);
+      curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+      curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, download_progress);
+      curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, &transfer);
+      curl_easy_perform(curl);
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
+
+      if (fp && chunk.offset && !transfer.insufficient)
+        fwrite(chunk.data, 1, chunk.offset, fp);
+
+      ProgressEvent::instance().setStep(ProgressEvent::instance().getMax());
     }
   }
 
-  fclose(chunk.out);
-  if (!can_download) {
-    brls::Application::crash("app/errors/insufficient_storage"_i18n);
-    std::this_thread::sleep_for(std::chrono::microseconds(2000000));
-    brls::Application::quit();
+  if (chunk.out)
+    fclose(chunk.out);
+  if (transfer.insufficient) {
+    insufficientStorage();
     res = {};
   }
 
@@ -214,19 +237,110 @@ long downloadFile(const std::string& url, std::vector<std::uint8_t>& res, const
   return status_code;
 }
 
+long downloadStream(const std::string& url, RingBuffer& pipe)
+{
+  Handle curl;
+  Transfer transfer;
+  long status_code = 0;
+  time_old         = std::chrono::steady_clock::now();
+  dlold            = 0.0f;
+  transfer.factor  = 1.1;
+
+  if (curl) {
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, API_AGENT);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteStreamCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &pipe);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, nullptr);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, download_progress);
+    curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, &transfer);
+    // a dropped connection still leaves the 200 from the headers behind
+    if (curl_easy_perform(curl) == CURLE_OK)
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
+  }
+
+  // lets the extractor see the end of the archive (or of what arrived of it)
+  pipe.close();
+
+  if (transfer.insufficient)
+    insufficientStorage();
+
+  return status_code;
+}
+
+long downloadResumable(const std::string& url, const std::string& output, int connections)
+{
+  ranged::Probe info;
+  if (!ranged::probe(url, info)) {
+    brls::sync([url]() { brls::Logger::info("{} does not take ranges; downloading in one go", url); });
+    std::filesystem::remove(ranged::statePath(output));
+    return downloadFile(url, output);
+  }
+
+  auto ranges = ranged::loadState(output, url, info);
+  if (!ranges.empty()) {
+    brls::sync([done = ranged::received(ranges), size = info.size]() {
+      brls::Logger::info("Resuming download at {}/{} bytes", done, size);
+    });
+  } else {
+    if (!hasSpace(info.size * 2.5)) {
+      insufficientStorage();
+      return 0;
+    }
+    ranges = ranged::split(info.size, std::max(connections, 1));
+    if (!ranged::createFile(output, info.size))
+      return 0;
+  }
+
+  time_old = std::chrono::steady_clock::now();
+  dlold    = ranged::received(ranges);
+
+  auto progress = [](int64_t size, int64_t done) {
+    report(size, done);
+    return !ProgressEvent::instance().getInterupt();
+  };
+
+  // dropped connections are retried from where each range stopped
+  for (int attempt = 0; attempt < RangeAttempts && !ranged::complete(ranges); attempt++) {
+    if (ProgressEvent::instance().getInterupt())
+      break;
+    if (ranged::fetch(url, output, info, ranges, progress))
+      continue;
+
+    // the file changed on the server since the partial download began
+    brls::sync([]() { brls::Logger::warning("Remote file changed; restarting the download"); });
+    if (!ranged::probe(url, info) || !ranged::createFile(output, info.size)) {
+      std::filesystem::remove(ranged::statePath(output));
+      return downloadFile(url, output);
+    }
+    ranges = ranged::split(info.size, std::max(connections, 1));
+    dlold  = 0;
+  }
+
+  if (!ranged::complete(ranges))
+    return 0;
+
+  std::filesystem::remove(ranged::statePath(output));
+  ProgressEvent::instance().setStep(ProgressEvent::instance().getMax());
+  return 206;
+}
+
 long downloadPage(
     const std::string& url, std::string& res, const std::vector<std::string>& headers, const std::string& body)
 {
-  CURL* curl_handle;
+  Handle curl_handle;
   struct MemoryStruct chunk;
   struct curl_slist* list = NULL;
-  long status_code;
+  long status_code        = 0;
 
-  chunk.memory = static_cast<char*>(malloc(1));
-  chunk.size   = 0;
+  chunk.memory    = static_cast<char*>(malloc(1));
+  chunk.size      = 0;
+  chunk.memory[0] = 0;
 
-  curl_global_init(CURL_GLOBAL_ALL);
-  curl_handle = curl_easy_init();
   curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
   if (!headers.empty()) {
     for (auto& h : headers) {
@@ -246,11 +360,10 @@ long downloadPage(
   curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0L);
   curl_easy_perform(curl_handle);
   curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &status_code);
-  curl_easy_cleanup(curl_handle);
+  curl_slist_free_all(list);
   res = std::string(chunk.memory);
   free(chunk.memory);
 
-  curl_global_cleanup();
   return status_code;
 }
 
@@ -269,6 +382,10 @@ long getRequest(const std::string& url, nlohmann::ordered_json& res, const std::
   return status_code;
 }
 
-void init() { curl_global_init(CURL_GLOBAL_ALL); }
+void init()
+{
+  curl_global_init(CURL_GLOBAL_ALL);
+  CurlPool::instance();
+}
 
 } // namespace download
\ No newline at end of file
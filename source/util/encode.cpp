@@ -0,0 +1,125 @@
+#include "util/encode.hpp"
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "extern/stb_image_write.h"
+
+namespace encode {
+
+namespace {
+  constexpr unsigned char Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  constexpr unsigned char Paeth        = 4;
+  constexpr size_t ChunkReserve        = 0x4000;
+
+  void be32(std::vector<unsigned char>& out, uint32_t value)
+  {
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+  }
+
+  // length and type, data already in out from start on, then the CRC over type and data
+  void closeChunk(std::vector<unsigned char>& out, size_t start)
+  {
+    auto length = static_cast<uint32_t>(out.size() - start - 8);
+    for (int i = 0; i < 4; i++)
+      out[start + i] = length >> (24 - i * 8);
+    be32(out, crc32(0, out.data() + start + 4, length + 4));
+  }
+
+  size_t openChunk(std::vector<unsigned char>& out, const char* type)
+  {
+    auto start = out.size();
+    out.insert(out.end(), 4, 0);
+    out.insert(out.end(), type, type + 4);
+    return start;
+  }
+
+  unsigned char predict(int a, int b, int c)
+  {
+    int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+    if (pa <= pb && pa <= pc)
+      return a;
+    return pb <= pc ? b : c;
+  }
+
+  // filter byte followed by the row, Paeth-filtered against prev (nullptr for the first row)
+  void filterRow(const unsigned char* row, const unsigned char* prev, size_t stride, unsigned char* out)
+  {
+    out[0] = Paeth;
+    for (size_t i = 0; i < stride; i++) {
+      int a = i >= 4 ? row[i - 4] : 0;
+      int b = prev ? prev[i] : 0;
+      int c = prev && i >= 4 ? prev[i - 4] : 0;
+      out[i + 1] = row[i] - predict(a, b, c);
+    }
+  }
+}
+
+bool png(ImageView image, std::vector<unsigned char>& out)
+{
+  if (!image)
+    return false;
+
+  out.insert(out.end(), Signature, Signature + sizeof(Signature));
+
+  auto header = openChunk(out, "IHDR");
+  be32(out, image.x);
+  be32(out, image.y);
+  // 8 bit RGBA, deflate, adaptive filtering, no interlace
+  out.insert(out.end(), { 8, 6, 0, 0, 0 });
+  closeChunk(out, header);
+
+  z_stream stream {};
+  if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15, 8, Z_RLE) != Z_OK)
+    return false;
+
+  auto data   = openChunk(out, "IDAT");
+  auto stride = static_cast<size_t>(image.x) * 4;
+  std::vector<unsigned char> row(stride + 1);
+
+  auto pump = [&](int flush) {
+    do {
+      auto written = out.size();
+      out.resize(written + ChunkReserve);
+      stream.next_out  = out.data() + written;
+      stream.avail_out = ChunkReserve;
+      deflate(&stream, flush);
+      out.resize(out.size() - stream.avail_out);
+    } while (stream.avail_out == 0);
+  };
+
+  for (int y = 0; y < image.y; y++) {
+    auto* line = image.data + y * stride;
+    filterRow(line, y ? line - stride : nullptr, stride, row.data());
+    stream.next_in  = row.data();
+    stream.avail_in = row.size();
+    pump(Z_NO_FLUSH);
+  }
+  stream.avail_in = 0;
+  pump(Z_FINISH);
+  deflateEnd(&stream);
+  closeChunk(out, data);
+
+  closeChunk(out, openChunk(out, "IEND"));
+  return true;
+}
+
+bool jpg(ImageView image, std::vector<unsigned char>& out, int quality)
+{
+  if (!image)
+    return false;
+
+  auto append = [](void* context, void* bytes, int size) {
+    auto* buffer = static_cast<std::vector<unsigned char>*>(context);
+    buffer->insert(buffer->end(), static_cast<unsigned char*>(bytes), static_cast<unsigned char*>(bytes) + size);
+  };
+  return stbi_write_jpg_to_func(append, &out, image.x, image.y, 4, image.data, quality) != 0;
+}
+}
@@ -8,10 +8,13 @@
 #include <borealis.hpp>
 #include <chrono>
 #include <filesystem>
-#include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "util/extract_entries.hpp"
 #include "util/progress_event.hpp"
+#include "util/ring_buffer.hpp"
 
 using namespace brls::literals; // for _i18n
 namespace fs     = std::filesystem;
@@ -51,10 +54,41 @@ void ensureAvailableStorage(size_t uncompressedSize)
   }
 }
 
-void extract(const std::string& archivePath, const std::string& workingPath, bool overwriteExisting)
+namespace {
+  constexpr size_t StreamBlockSize = 0x10000;
+
+  struct StreamSource {
+    RingBuffer& pipe;
+    std::vector<char> block = std::vector<char>(StreamBlockSize);
+  };
+
+  la_ssize_t readStream(struct archive*, void* userdata, const void** buff)
+  {
+    auto* source = static_cast<StreamSource*>(userdata);
+    *buff        = source->block.data();
+    return source->pipe.read(source->block.data(), source->block.size());
+  }
+
+  int report(const Result& res, bool manifest)
+  {
+    brls::sync([res, manifest]() {
+      if (!res.error.empty())
+        brls::Logger::error("{}", res.error);
+      if (manifest && res.complete)
+        brls::Logger::info(
+            "Manifest: {} unchanged entries skipped, {} removed entries deleted", res.skipped, res.removed);
+    });
+    return res.written;
+  }
+}
+
+bool extract(const std::string& archivePath, const std::string& workingPath, bool overwriteExisting,
+    const std::function<void(const fs::path&)>& onFile, manifest::Manifest* manifest,
+    const std::function<bool(const fs::path&)>& exists)
 {
-  auto start = std::chrono::high_resolution_clock::now();
-  int count  = 0;
+  auto start    = std::chrono::high_resolution_clock::now();
+  int count     = 0;
+  bool complete = false;
 
   try {
 
@@ -69,8 +103,7 @@ void extract(const std::string& archivePath, const std::string& workingPath, boo
     ProgressEvent::instance().setStep(0);
 
     ArchivePtr archive(archive_read_new(), archive_read_free);
-    struct archive_entry* entry;
-    int err = 0, i = 0;
+    int err = 0;
 
     archive_read_support_format_all(archive.get());
     archive_read_support_filter_all(archive.get());
@@ -79,82 +112,61 @@ void extract(const std::string& archivePath, const std::string& workingPath, boo
       brls::sync([err = std::string(archive_error_string(archive.get()))]() {
         brls::Logger::error("Error opening archive: {}", err);
       });
-      return;
+      return false;
     }
 
-    for (;;) {
-      if (ProgressEvent::instance().getInterupt()) {
-        ProgressEvent::instance().setStep(ProgressEvent::instance().getMax());
-        break;
-      }
-
-      err = archive_read_next_header(archive.get(), &entry);
-      if (err == ARCHIVE_EOF) {
-        ProgressEvent::instance().setStep(ProgressEvent::instance().getMax());
-        break;
-      }
-      if (err < ARCHIVE_OK)
-        brls::sync([archivePath, err = std::string(archive_error_string(archive.get()))]() {
-          brls::Logger::error("Error reading archive entry: {}", err);
-        });
-      if (err < ARCHIVE_WARN) {
-        break;
-      }
-
-      auto filepath = fs::path(workingPath) / archive_entry_pathname(entry);
-
-      if (archive_entry_filetype(entry) == AE_IFDIR) {
-        fs::create_directories(filepath);
-        ProgressEvent::instance().setStep(++i);
-        continue;
-      }
-
-      if (fs::exists(filepath) && !overwriteExisting) {
-        ProgressEvent::instance().setStep(++i);
-        continue;
-      }
-
-      std::ofstream outfile(filepath.string(), std::ios::binary | std::ios::trunc);
-      if (!outfile.is_open()) {
-        brls::sync([path = filepath.string()]() {
-          brls::Logger::error("Error opening write file for archive entry: {}", path);
-        });
-        break;
-      }
-
-      const void* buff = nullptr;
-      size_t size      = 0;
-      int64_t offset   = 0;
-      int res          = -1;
-      while ((res = archive_read_data_block(archive.get(), &buff, &size, &offset)) == ARCHIVE_OK) {
-        try {
-          outfile.write(static_cast<const char*>(buff), size);
-        } catch (const std::exception& e) {
-          res = ARCHIVE_FATAL;
-          break;
-        }
-      }
-
-      if (res != ARCHIVE_EOF) {
-        brls::sync([res = std::string(archive_error_string(archive.get()))]() {
-          brls::Logger::error("Error writing out archive entry: {}", res);
-        });
-        outfile.close();
-        fs::remove(filepath);
-        break;
-      }
-
-      count++;
-      ProgressEvent::instance().setStep(++i);
+    auto res = extractEntries(archive.get(), workingPath, overwriteExisting, onFile, manifest, exists, true);
+    count    = report(res, manifest != nullptr);
+    complete = res.complete;
+
+  } catch (const std::exception& e) {
+    brls::sync([e = std::string(e.what())]() { brls::Logger::error("Unexpected error extracting archive: {}", e); });
+  }
+
+  auto end     = std::chrono::high_resolution_clock::now();
+  auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
+
+  brls::sync([elapsed, count]() { brls::Logger::info("Total extraction time: {}s for {} files", elapsed, count); });
+  return complete;
+}
+
+bool extract(RingBuffer& pipe, const std::string& workingPath, bool overwriteExisting,
+    const std::function<void(const fs::path&)>& onFile, manifest::Manifest* manifest,
+    const std::function<bool(const fs::path&)>& exists)
+{
+  auto start    = std::chrono::high_resolution_clock::now();
+  int count     = 0;
+  bool complete = false;
+
+  try {
+    StreamSource source { pipe };
+    ArchivePtr archive(archive_read_new(), archive_read_free);
+    int err = 0;
+
+    archive_read_support_format_all(archive.get());
+    archive_read_support_filter_all(archive.get());
+
+    if ((err = archive_read_open(archive.get(), &source, nullptr, readStream, nullptr))) {
+      brls::sync([err = std::string(archive_error_string(archive.get()))]() {
+        brls::Logger::error("Error opening archive stream: {}", err);
+      });
+    } else {
+      auto res = extractEntries(archive.get(), workingPath, overwriteExisting, onFile, manifest, exists, false);
+      count    = report(res, manifest != nullptr);
+      complete = res.complete;
     }
 
   } catch (const std::exception& e) {
     brls::sync([e = std::string(e.what())]() { brls::Logger::error("Unexpected error extracting archive: {}", e); });
   }
 
+  // stops the download if extraction bailed out early; a no-op once the whole archive was read
+  pipe.abort();
+
   auto end     = std::chrono::high_resolution_clock::now();
   auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
 
   brls::sync([elapsed, count]() { brls::Logger::info("Total extraction time: {}s for {} files", elapsed, count); });
+  return complete;
+}
 }
-}
\ No newline at end of file
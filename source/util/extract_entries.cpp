@@ -0,0 +1,285 @@
+#include "util/extract_entries.hpp"
+
+#include <archive.h>
+#include <archive_entry.h>
+#include <fmt/format.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "util/manifest.hpp"
+#include "util/progress_event.hpp"
+
+namespace fs = std::filesystem;
+
+namespace extract {
+
+namespace {
+  constexpr int WriterCount      = 3;
+  constexpr size_t QueueCapacity = 0x800000;
+
+  struct WriteJob {
+    fs::path path;
+    std::vector<char> data;
+  };
+
+  // decoded entries waiting for a writer, bounded by the bytes they hold so a slow card throttles decoding; an entry
+  // larger than the whole capacity is still let through once the queue has drained
+  class WriteQueue {
+  public:
+    bool push(WriteJob&& job)
+    {
+      std::unique_lock lock(mutex);
+      space.wait(lock, [this, &job]() {
+        return stopped || pending == 0 || pending + job.data.size() <= QueueCapacity;
+      });
+      if (stopped)
+        return false;
+
+      pending += job.data.size();
+      jobs.push_back(std::move(job));
+      ready.notify_one();
+      return true;
+    }
+
+    std::optional<WriteJob> pop()
+    {
+      std::unique_lock lock(mutex);
+      ready.wait(lock, [this]() { return stopped || closed || !jobs.empty(); });
+      if (stopped || jobs.empty())
+        return std::nullopt;
+
+      auto job = std::move(jobs.front());
+      jobs.pop_front();
+      pending -= job.data.size();
+      space.notify_one();
+      return job;
+    }
+
+    // no more jobs; writers finish what is queued
+    void close()
+    {
+      std::lock_guard lock(mutex);
+      closed = true;
+      ready.notify_all();
+    }
+
+    // drop whatever is queued and unblock both sides
+    void stop()
+    {
+      std::lock_guard lock(mutex);
+      stopped = true;
+      jobs.clear();
+      ready.notify_all();
+      space.notify_all();
+    }
+
+    // stop, keeping the first reason given
+    void fail(std::string reason)
+    {
+      {
+        std::lock_guard lock(mutex);
+        if (error.empty())
+          error = std::move(reason);
+      }
+      stop();
+    }
+
+    bool isStopped()
+    {
+      std::lock_guard lock(mutex);
+      return stopped;
+    }
+
+    std::string firstError()
+    {
+      std::lock_guard lock(mutex);
+      return error;
+    }
+
+  private:
+    std::deque<WriteJob> jobs;
+    size_t pending = 0;
+    bool closed    = false;
+    bool stopped   = false;
+    std::string error;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+  };
+
+  void advance(bool steps)
+  {
+    ProgressEvent::instance().incrementFiles();
+    if (steps)
+      ProgressEvent::instance().incrementStep(1);
+  }
+
+  // each entry arrives fully decoded, so it goes out in a single unbuffered write
+  void writeOut(WriteQueue& queue, std::atomic_int& written, bool steps)
+  {
+    while (auto job = queue.pop()) {
+      if (ProgressEvent::instance().getInterupt()) {
+        queue.stop();
+        break;
+      }
+
+      FILE* file = fopen(job->path.c_str(), "wb");
+      if (!file) {
+        queue.fail(fmt::format("Error opening write file for archive entry: {}", job->path.string()));
+        break;
+      }
+
+      setvbuf(file, nullptr, _IONBF, 0);
+      bool ok = fwrite(job->data.data(), 1, job->data.size(), file) == job->data.size();
+      ok      = fclose(file) == 0 && ok;
+
+      if (!ok) {
+        std::error_code ec;
+        fs::remove(job->path, ec);
+        queue.fail(fmt::format("Error writing out archive entry: {}", job->path.string()));
+        break;
+      }
+
+      written++;
+      advance(steps);
+    }
+  }
+
+  // deletes what the archive dropped and saves the manifest; only after a clean pass
+  bool applyManifest(manifest::Manifest& manifest, const std::string& workingPath, Result& res)
+  {
+    auto removed = manifest.removed();
+    for (auto& name : removed) {
+      std::error_code ec;
+      fs::remove(fs::path(workingPath) / name, ec);
+    }
+    res.removed = removed.size();
+
+    if (!manifest.save()) {
+      res.error = "Error saving extraction manifest";
+      return false;
+    }
+    return true;
+  }
+}
+
+Result extractEntries(struct archive* archive, const std::string& workingPath, bool overwriteExisting,
+    const std::function<void(const fs::path&)>& onFile, manifest::Manifest* manifest,
+    const std::function<bool(const fs::path&)>& exists, bool steps)
+{
+  Result res;
+  struct archive_entry* entry;
+  int err                 = 0;
+  bool complete           = false;
+  std::atomic_int written = 0;
+
+  // directories are created once, here, so writers never race on them and repeated parents cost no stat
+  std::unordered_set<std::string> directories;
+  auto ensureDirectory = [&directories](const fs::path& path) {
+    if (directories.insert(path.string()).second)
+      fs::create_directories(path);
+  };
+
+  WriteQueue queue;
+  std::vector<std::jthread> writers;
+  for (int i = 0; i < WriterCount; i++)
+    writers.emplace_back(writeOut, std::ref(queue), std::ref(written), steps);
+
+  try {
+    for (;;) {
+      if (ProgressEvent::instance().getInterupt() || queue.isStopped())
+        break;
+
+      err = archive_read_next_header(archive, &entry);
+      if (err == ARCHIVE_EOF) {
+        complete = true;
+        break;
+      }
+      if (err < ARCHIVE_WARN) {
+        queue.fail(fmt::format("Error reading archive entry: {}", archive_error_string(archive)));
+        break;
+      }
+
+      auto filepath = fs::path(workingPath) / archive_entry_pathname(entry);
+
+      if (archive_entry_filetype(entry) == AE_IFDIR) {
+        ensureDirectory(filepath);
+        advance(steps);
+        continue;
+      }
+
+      if (onFile)
+        onFile(filepath);
+
+      // without a manifest there is nothing to compare against, so an existing file is only rewritten on request
+      bool present = exists ? exists(filepath) : fs::exists(filepath);
+      if (present && !overwriteExisting && !manifest) {
+        advance(steps);
+        continue;
+      }
+
+      WriteJob job { filepath, {} };
+      if (archive_entry_size_is_set(entry) && archive_entry_size(entry) > 0)
+        job.data.reserve(archive_entry_size(entry));
+
+      const void* buff = nullptr;
+      size_t size      = 0;
+      int64_t offset   = 0;
+      int block        = -1;
+      while ((block = archive_read_data_block(archive, &buff, &size, &offset)) == ARCHIVE_OK) {
+        if (static_cast<size_t>(offset) > job.data.size())
+          job.data.resize(offset);
+        job.data.insert(job.data.end(), static_cast<const char*>(buff), static_cast<const char*>(buff) + size);
+      }
+
+      if (block != ARCHIVE_EOF) {
+        queue.fail(fmt::format("Error reading archive entry data: {}", archive_error_string(archive)));
+        break;
+      }
+
+      if (manifest) {
+        auto state = manifest->record(
+            archive_entry_pathname(entry), manifest::Manifest::hash(job.data.data(), job.data.size()));
+        bool keep  = state == manifest::State::UNCHANGED || (state == manifest::State::NEW && !overwriteExisting);
+        if (present && keep) {
+          res.skipped++;
+          advance(steps);
+          continue;
+        }
+      }
+
+      ensureDirectory(filepath.parent_path());
+      if (!queue.push(std::move(job)))
+        break;
+    }
+  } catch (...) {
+    queue.stop();
+    throw;
+  }
+
+  if (ProgressEvent::instance().getInterupt())
+    queue.stop();
+  queue.close();
+  writers.clear();
+
+  res.written  = written;
+  res.error    = queue.firstError();
+  res.complete = complete && !queue.isStopped();
+
+  // only a clean pass may replace the manifest; otherwise the next update compares against the old one again
+  if (manifest && res.complete)
+    res.complete = applyManifest(*manifest, workingPath, res);
+
+  if (steps)
+    ProgressEvent::instance().setStep(ProgressEvent::instance().getMax());
+
+  return res;
+}
+}
@@ -4,10 +4,9 @@
 
 #include <algorithm>
 #include <cstring>
-#include <span>
+#include <fstream>
 #include <utility>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 
 #include <xxhash.h>
@@ -15,38 +14,56 @@
 #include "extern/nanovg/stb_image.h"
 #include "extern/stb_image_resize2.h"
 #include "extern/stb_image_write.h"
+#include "util/blend.hpp"
+#include "util/decode.hpp"
+#include "util/encode.hpp"
+#include "util/pack.hpp"
+#include "util/pixel_pool.hpp"
 
+namespace {
+  // 256x256 buffers come from the pool, anything else from malloc
+  Image::Handle allocateBuffer(size_t size)
+  {
+    if (size == PixelPool::BufferSize)
+      return PixelPool::instance().acquire();
+    return Image::Handle(static_cast<unsigned char*>(malloc(size)), Image::HandleDeleter());
+  }
+}
+
+// shares the pixels; see mutableData
 Image::Image(const Image& other)
+    : data(other.data)
+    , size(other.size)
+    , pixels(other.pixels)
+    , x(other.x)
+    , y(other.y)
+    , n(other.n)
+    , displayAlpha(other.displayAlpha)
 {
-  data.reset(static_cast<unsigned char*>(malloc(other.size)));
-  if (data && other.data) {
-    std::memcpy(data.get(), other.data.get(), other.size);
-    size   = other.size;
-    pixels = other.pixels;
-    x      = other.x;
-    y      = other.y;
-    n      = other.n;
-  }
 }
 
 Image::Image(Image&& other) noexcept
 {
-  data = std::exchange(other.data, nullptr);
-  size = std::exchange(other.size, 0);
-  x    = std::exchange(other.x, 0);
-  y    = std::exchange(other.y, 0);
-  n    = std::exchange(other.n, 0);
+  data         = std::exchange(other.data, nullptr);
+  size         = std::exchange(other.size, 0);
+  pixels       = std::exchange(other.pixels, 0);
+  x            = std::exchange(other.x, 0);
+  y            = std::exchange(other.y, 0);
+  n            = std::exchange(other.n, 0);
+  displayAlpha = std::exchange(other.displayAlpha, 1.0f);
 }
 
 Image& Image::operator=(const Image& other) { return *this = Image(other); }
 
 Image& Image::operator=(Image&& other)
 {
-  data = std::exchange(other.data, nullptr);
-  size = std::exchange(other.size, 0);
-  x    = std::exchange(other.x, 0);
-  y    = std::exchange(other.y, 0);
-  n    = std::exchange(other.n, 0);
+  data         = std::exchange(other.data, nullptr);
+  size         = std::exchange(other.size, 0);
+  pixels       = std::exchange(other.pixels, 0);
+  x            = std::exchange(other.x, 0);
+  y            = std::exchange(other.y, 0);
+  n            = std::exchange(other.n, 0);
+  displayAlpha = std::exchange(other.displayAlpha, 1.0f);
   return *this;
 }
 
@@ -63,14 +80,27 @@ Image::Image(int x, int y)
 
 bool Image::allocate()
 {
-  data.reset(static_cast<unsigned char*>(calloc(size / sizeof(char), sizeof(char))));
+  data = allocateBuffer(size);
+  if (data)
+    std::memset(data.get(), 0, size);
 
   return (bool)data;
 }
 
+unsigned char* Image::mutableData()
+{
+  if (data && data.use_count() > 1) {
+    auto copy = allocateBuffer(size);
+    if (copy)
+      std::memcpy(copy.get(), data.get(), size);
+    data = std::move(copy);
+  }
+  return data.get();
+}
+
 Image::Image(unsigned char* buffer, size_t size)
 {
-  this->data.reset(stbi_load_from_memory(buffer, size, &x, &y, &n, 4));
+  this->data.reset(stbi_load_from_memory(buffer, size, &x, &y, &n, 4), HandleDeleter());
   this->n      = 4;
   this->pixels = x * y;
   this->size   = pixels * 4 * sizeof(char);
@@ -80,14 +110,36 @@ Image::Image(std::string file)
 {
   stbi_set_unpremultiply_on_load(1);
   stbi_convert_iphone_png_to_rgb(1);
-  this->data.reset(stbi_load(file.c_str(), &x, &y, &n, 4));
+
+  std::vector<unsigned char> packed;
+  if (pack::read(file, packed))
+    this->data.reset(stbi_load_from_memory(packed.data(), packed.size(), &x, &y, &n, 4), HandleDeleter());
+  else
+    this->data.reset(stbi_load(file.c_str(), &x, &y, &n, 4), HandleDeleter());
   this->pixels = x * y;
   this->size   = pixels * 4 * sizeof(char);
 }
 
+Image::Image(const std::string& file, int x, int y)
+{
+  // the decoder overwrites every pixel, so the buffer skips allocate()'s clearing
+  auto target = [this, x, y]() {
+    *this = Image(nullptr, x, y, 4);
+    data  = allocateBuffer(size);
+    return mutableView();
+  };
+  if (decode::scaled(file, x, y, target))
+    return;
+
+  *this = Image(file);
+  resize(x, y);
+}
+
 Image::Image(unsigned char* img, int x, int y, int n)
 {
-  this->data.reset(img);
+  // an empty Image has no control block to allocate
+  if (img)
+    this->data.reset(img, HandleDeleter());
   this->x      = x;
   this->y      = y;
   this->n      = n;
@@ -98,91 +150,113 @@ Image::Image(unsigned char* img, int x, int y, int n)
 void Image::resize(int x, int y)
 {
   if (this->x != x || this->y != y) {
-    auto* resized
-        = stbir_resize_uint8_linear(data.get(), this->x, this->y, 0, nullptr, x, y, 0, stbir_pixel_layout::STBIR_RGBA);
-    if (resized) {
-      *this = Image(resized, x, y, 4);
+    auto resized = allocateBuffer(static_cast<size_t>(x) * y * 4);
+    if (resized && resize(view(), { resized.get(), x, y })) {
+      this->data   = std::move(resized);
+      this->x      = x;
+      this->y      = y;
+      this->n      = 4;
+      this->pixels = x * y;
+      this->size   = pixels * 4 * sizeof(char);
     }
   }
 }
 
-bool Image::writeJpg(std::filesystem::path path)
+bool Image::writeJpg(std::filesystem::path path) { return writeJpg(view(), std::move(path)); }
+
+bool Image::writePng(std::filesystem::path path, PngEncoder encoder)
+{
+  return writePng(view(), std::move(path), encoder);
+}
+
+bool Image::encodePng(std::vector<unsigned char>& out, PngEncoder encoder) { return encodePng(view(), out, encoder); }
+
+bool Image::encodeJpg(std::vector<unsigned char>& out, int quality) { return encodeJpg(view(), out, quality); }
+
+void Image::applyAlpha(float alpha) { Image::applyAlpha(*this, std::clamp(alpha, 0.0f, 1.0f)); }
+
+std::string Image::hash() { return hash(view()); }
+
+void Image::merge(Image& top, Image& bottom, Image& output) { merge(top.view(), bottom.view(), output.mutableView()); }
+
+void Image::merge(Image& frame, Image& character, Image& background, Image& output)
+{
+  merge(frame.view(), character.view(), background.view(), output.mutableView());
+}
+
+void Image::applyAlpha(Image& image, float alpha)
+{
+  if (image.data)
+    applyAlpha(image.mutableView(), alpha);
+}
+
+bool Image::resize(ImageView source, MutableImageView output)
+{
+  if (!source || !output)
+    return false;
+  return stbir_resize_uint8_linear(source.data, source.x, source.y, 0, output.data, output.x, output.y, 0,
+             stbir_pixel_layout::STBIR_RGBA)
+      != nullptr;
+}
+
+bool Image::writeJpg(ImageView image, std::filesystem::path path)
 {
   if (path.extension() != ".jpg")
     path.replace_extension(".jpg");
-  return stbi_write_jpg(path.c_str(), x, y, 4, data.get(), 90) != 0;
+  return stbi_write_jpg(path.c_str(), image.x, image.y, 4, image.data, 90) != 0;
 }
 
-bool Image::writePng(std::filesystem::path path)
+bool Image::writePng(ImageView image, std::filesystem::path path, PngEncoder encoder)
 {
   if (path.extension() != ".png")
     path.replace_extension(".png");
-  return stbi_write_png(path.c_str(), x, y, 4, data.get(), 0) != 0;
-}
+  if (encoder == PngEncoder::STB)
+    return stbi_write_png(path.c_str(), image.x, image.y, 4, image.data, 0) != 0;
 
-void Image::applyAlpha(float alpha) { Image::applyAlpha(*this, std::clamp(alpha, 0.0f, 1.0f)); }
+  std::vector<unsigned char> png;
+  if (!encode::png(image, png))
+    return false;
+  std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  stream.write(reinterpret_cast<const char*>(png.data()), png.size());
+  return stream.good();
+}
 
-std::string Image::hash()
+bool Image::encodePng(ImageView image, std::vector<unsigned char>& out, PngEncoder encoder)
 {
-  if (data) {
-    auto xxh = XXH3_64bits(data.get(), pixels * 4 * sizeof(char));
-    return fmt::format("{}", xxh);
-  }
+  if (encoder == PngEncoder::FAST)
+    return encode::png(image, out);
 
-  return "";
+  auto append = [](void* context, void* bytes, int size) {
+    auto* buffer = static_cast<std::vector<unsigned char>*>(context);
+    buffer->insert(buffer->end(), static_cast<unsigned char*>(bytes), static_cast<unsigned char*>(bytes) + size);
+  };
+  return stbi_write_png_to_func(append, &out, image.x, image.y, 4, image.data, 0) != 0;
 }
 
-#pragma pack(push, 1)
-struct Pixel {
-  uint8_t r, g, b, a;
+bool Image::encodeJpg(ImageView image, std::vector<unsigned char>& out, int quality)
+{
+  return encode::jpg(image, out, quality);
+}
 
-  static Pixel blend(Pixel& a, Pixel& b)
-  {
+std::string Image::hash(ImageView image)
+{
+  if (image)
+    return fmt::format("{}", XXH3_64bits(image.data, image.size()));
 
-    auto blender = [](uint8_t a, uint8_t b, uint8_t alpha) {
-      return static_cast<uint8_t>(((a * alpha) + (b * (255 - alpha))) / 255);
-    };
+  return "";
+}
 
-    return Pixel { .r = blender(a.r, b.r, a.a), .g = blender(a.g, b.g, a.a), .b = blender(a.b, b.b, a.a), .a = 0xff };
-  }
-};
-#pragma pack(pop)
+void Image::applyAlpha(MutableImageView image, float alpha) { blend::scaleAlpha(image.data, image.pixels(), alpha); }
 
-// assumes images same size, little endian, RGBA channels
-void Image::merge(Image& frame, Image& character, Image& background, Image& output)
+// assumes images same size, RGBA channels
+void Image::merge(ImageView top, ImageView bottom, MutableImageView output)
 {
-  auto total = frame.x * frame.y;
-
-  std::span frameRef { reinterpret_cast<Pixel*>(frame.data.get()), frame.size / sizeof(Pixel) };
-  std::span characterRef { reinterpret_cast<Pixel*>(character.data.get()), character.size / sizeof(Pixel) };
-  std::span backgroundRef { reinterpret_cast<Pixel*>(background.data.get()), background.size / sizeof(Pixel) };
-  std::span outputRef { reinterpret_cast<Pixel*>(output.data.get()), output.size / sizeof(Pixel) };
-
-  for (auto i = 0; i < total; i++) {
-    // frame blocking
-    if (frameRef[i].a == 0xff) {
-      outputRef[i] = frameRef[i];
-      // character blocking
-    } else if (frameRef[i].a == 0 && characterRef[i].a == 0xff) {
-      outputRef[i] = characterRef[i];
-      // background only
-    } else if (frameRef[i].a == 0 && characterRef[i].a == 0) {
-      outputRef[i] = backgroundRef[i];
-    }
-    // blend
-    else {
-      outputRef[i] = Pixel::blend(characterRef[i], backgroundRef[i]);
-      outputRef[i] = Pixel::blend(frameRef[i], outputRef[i]);
-    }
-  }
+  blend::over(top.data, bottom.data, output.data, top.pixels());
 }
 
-void Image::applyAlpha(Image& image, float alpha)
+// character over background, then frame over that
+void Image::merge(ImageView frame, ImageView character, ImageView background, MutableImageView output)
 {
-  auto total = image.x * image.y;
-  auto ref   = std::span(reinterpret_cast<Pixel*>(image.data.get()), image.size / sizeof(Pixel));
-
-  for (auto i = 0; i < total; i++) {
-    ref[i] = Pixel { ref[i].r, ref[i].g, ref[i].b, static_cast<uint8_t>(static_cast<float>(ref[i].a) * alpha) };
-  }
-}
\ No newline at end of file
+  blend::over(character.data, background.data, output.data, frame.pixels());
+  blend::over(frame.data, output.data, output.data, frame.pixels());
+}
@@ -0,0 +1,66 @@
+#include "util/layer_cache.hpp"
+
+#include <fmt/format.h>
+
+#include <filesystem>
+
+#include "util/pack.hpp"
+
+namespace fs = std::filesystem;
+
+// about 64 layers at 256x256
+constexpr size_t LayerCacheBudget = 16 * 1024 * 1024;
+
+Image LayerCache::get(const std::string& path, int size)
+{
+  int64_t mtime;
+  uint64_t bytes;
+  if (!pack::stat(path, mtime, bytes)) {
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    if (ec)
+      return Image(path, size, size);
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+  }
+
+  auto key = fmt::format("{}|{}|{}", path, mtime, size);
+  {
+    std::lock_guard lock(mutex);
+    if (auto it = index.find(key); it != index.end()) {
+      counters.hits++;
+      entries.splice(entries.begin(), entries, it->second);
+      return it->second->image;
+    }
+    counters.misses++;
+  }
+
+  Image image(path, size, size);
+  if (!image.data)
+    return image;
+
+  std::lock_guard lock(mutex);
+  // another thread may have decoded the same layer in the meantime
+  if (index.contains(key))
+    return image;
+
+  entries.push_front(Entry { key, image });
+  index[key] = entries.begin();
+  counters.bytes += image.size;
+
+  while (counters.bytes > LayerCacheBudget && entries.size() > 1) {
+    auto& last = entries.back();
+    counters.bytes -= last.image.size;
+    counters.evictions++;
+    index.erase(last.key);
+    entries.pop_back();
+  }
+  return image;
+}
+
+LayerCache::Stats LayerCache::stats()
+{
+  std::lock_guard lock(mutex);
+  auto res    = counters;
+  res.entries = entries.size();
+  return res;
+}
@@ -0,0 +1,119 @@
+#include "util/manifest.hpp"
+
+#include <xxhash.h>
+
+#include <cstring>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace manifest {
+
+namespace {
+  constexpr char Magic[4]    = { 'N', 'S', 'O', 'M' };
+  constexpr uint32_t Version = 1;
+
+  template <typename T> bool read(std::ifstream& stream, T& value)
+  {
+    return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+  }
+
+  template <typename T> void write(std::ofstream& stream, T value)
+  {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+}
+
+Manifest::Manifest(fs::path file)
+    : file(std::move(file))
+{
+}
+
+bool Manifest::load()
+{
+  previous.clear();
+
+  std::ifstream stream(file, std::ios::binary);
+  if (!stream.is_open())
+    return false;
+
+  char magic[sizeof(Magic)];
+  uint32_t version = 0, count = 0;
+  if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 || !read(stream, version)
+      || version != Version || !read(stream, count))
+    return false;
+
+  previous.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint16_t length = 0;
+    uint64_t hash   = 0;
+    std::string name;
+    if (!read(stream, length))
+      break;
+    name.resize(length);
+    if (!stream.read(name.data(), length) || !read(stream, hash))
+      break;
+    previous[std::move(name)] = hash;
+  }
+
+  if (previous.size() != count) {
+    // a torn manifest is worse than none: it would hide entries that need writing
+    previous.clear();
+    return false;
+  }
+  return true;
+}
+
+size_t Manifest::size() const { return previous.size(); }
+
+bool Manifest::save() const
+{
+  auto temp = fs::path(file).replace_extension(".tmp");
+
+  {
+    std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open())
+      return false;
+
+    stream.write(Magic, sizeof(Magic));
+    write(stream, Version);
+    write(stream, static_cast<uint32_t>(current.size()));
+    for (auto& [name, hash] : current) {
+      write(stream, static_cast<uint16_t>(name.size()));
+      stream.write(name.data(), name.size());
+      write(stream, hash);
+    }
+
+    if (!stream.good())
+      return false;
+  }
+
+  // rename does not replace an existing file on the Switch's fsdev
+  std::error_code ec;
+  fs::remove(file, ec);
+  fs::rename(temp, file, ec);
+  return !ec;
+}
+
+State Manifest::record(const std::string& name, uint64_t hash)
+{
+  current[name] = hash;
+
+  auto it = previous.find(name);
+  if (it == previous.end())
+    return State::NEW;
+  return it->second == hash ? State::UNCHANGED : State::CHANGED;
+}
+
+std::vector<std::string> Manifest::removed() const
+{
+  std::vector<std::string> res;
+  for (auto& [name, hash] : previous) {
+    if (!current.count(name))
+      res.push_back(name);
+  }
+  return res;
+}
+
+uint64_t Manifest::hash(const void* data, size_t size) { return XXH3_64bits(data, size); }
+}
@@ -0,0 +1,536 @@
+#include "util/pack.hpp"
+
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <borealis.hpp>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "util/paths.hpp"
+
+namespace fs = std::filesystem;
+
+namespace pack {
+
+namespace {
+  constexpr char Magic[4]    = { 'N', 'S', 'O', 'P' };
+  constexpr uint32_t Version = 1;
+  // a few packs instead of one keeps a failed or interrupted write cheap to redo
+  constexpr uint64_t PackCapacity = 64 * 1024 * 1024;
+
+  constexpr unsigned char PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+  struct Entry {
+    uint32_t pack;
+    uint64_t offset;
+    uint32_t length;
+    uint16_t width;
+    uint16_t height;
+  };
+
+  // a part waiting to be packed, from a loose file or carried over from the current packs
+  struct Part {
+    std::string category;
+    std::string subcategory;
+    std::string name;
+    fs::path file;
+    uint32_t length;
+    uint16_t width;
+    uint16_t height;
+    bool packed = false;
+  };
+
+  std::shared_mutex mutex;
+  bool loaded       = false;
+  int64_t packStamp = 0;
+  std::vector<int> descriptors; // indexed by Entry::pack
+  std::unordered_map<std::string, Entry> entries; // keyed by path relative to paths::IconCachePath
+
+  template <typename T> bool read(std::ifstream& stream, T& value)
+  {
+    return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+  }
+
+  template <typename T> void write(std::ofstream& stream, T value)
+  {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  bool readString(std::ifstream& stream, std::string& value)
+  {
+    uint16_t length;
+    if (!read(stream, length))
+      return false;
+    value.resize(length);
+    return static_cast<bool>(stream.read(value.data(), length));
+  }
+
+  void writeString(std::ofstream& stream, std::string_view value)
+  {
+    write(stream, static_cast<uint16_t>(value.size()));
+    stream.write(value.data(), value.size());
+  }
+
+  // empty for paths outside the icon cache
+  std::string keyOf(std::string_view path)
+  {
+    if (!path.starts_with(paths::IconCachePath))
+      return {};
+    return std::string(path.substr(paths::IconCachePath.size()));
+  }
+
+  // every build writes a new generation next to the old packs, which go only once the new ones load; later
+  // generations sort last, so a leftover older pack can never shadow a newer part
+  fs::path packFile(int64_t generation, size_t index)
+  {
+    return fs::path(paths::PackPath) / fmt::format("parts-{:016x}-{:03}.pak", generation, index);
+  }
+
+  std::vector<fs::path> packFiles()
+  {
+    std::vector<fs::path> res;
+    std::error_code ec;
+    for (auto& file : fs::directory_iterator(paths::PackPath, ec)) {
+      if (file.is_regular_file() && file.path().extension() == ".pak")
+        res.push_back(file.path());
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+  }
+
+  // reads the dimensions from the IHDR chunk, which a valid PNG always has first
+  bool dimensions(const fs::path& file, uint16_t& width, uint16_t& height)
+  {
+    unsigned char header[24];
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream.read(reinterpret_cast<char*>(header), sizeof(header))
+        || std::memcmp(header, PngSignature, sizeof(PngSignature)) != 0 || std::memcmp(header + 12, "IHDR", 4) != 0)
+      return false;
+
+    auto be32 = [](const unsigned char* p) { return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; };
+
+    width  = static_cast<uint16_t>(be32(header + 16));
+    height = static_cast<uint16_t>(be32(header + 20));
+    return true;
+  }
+
+  // runs on the download thread, so a directory that cannot be read is skipped instead of throwing
+  template <typename F> void forEach(const fs::path& directory, F visit)
+  {
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+      visit(*it);
+  }
+
+  std::string partKey(const Part& part) { return part.category + "/" + part.subcategory + "/" + part.name; }
+
+  bool sortParts(const Part& a, const Part& b)
+  {
+    return std::tie(a.category, a.subcategory, a.name) < std::tie(b.category, b.subcategory, b.name);
+  }
+
+  std::vector<Part> scan()
+  {
+    std::vector<Part> res;
+    forEach(fs::path(paths::IconCachePath), [&res](const fs::directory_entry& category) {
+      std::error_code ec;
+      if (!category.is_directory(ec))
+        return;
+      forEach(category.path(), [&res, &category](const fs::directory_entry& subcategory) {
+        std::error_code ec;
+        if (!subcategory.is_directory(ec))
+          return;
+        forEach(subcategory.path(), [&res, &category, &subcategory](const fs::directory_entry& file) {
+          std::error_code ec;
+          if (!file.is_regular_file(ec) || file.path().extension() != ".png")
+            return;
+          auto size = file.file_size(ec);
+          if (ec)
+            return;
+
+          Part part { category.path().filename().string(), subcategory.path().filename().string(),
+            file.path().filename().string(), file.path(), static_cast<uint32_t>(size), 0, 0 };
+          if (dimensions(part.file, part.width, part.height))
+            res.push_back(std::move(part));
+        });
+      });
+    });
+
+    return res;
+  }
+
+  size_t headerSize(std::span<const Part> parts)
+  {
+    size_t res = sizeof(Magic) + sizeof(uint32_t) * 2;
+    for (auto& part : parts) {
+      res += sizeof(uint16_t) * 3 + part.category.size() + part.subcategory.size() + part.name.size();
+      res += sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) * 2;
+    }
+    return res;
+  }
+
+  bool writePack(const fs::path& file, std::span<const Part> parts)
+  {
+    std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open())
+      return false;
+
+    stream.write(Magic, sizeof(Magic));
+    write(stream, Version);
+    write(stream, static_cast<uint32_t>(parts.size()));
+
+    uint64_t offset = headerSize(parts);
+    for (auto& part : parts) {
+      writeString(stream, part.category);
+      writeString(stream, part.subcategory);
+      writeString(stream, part.name);
+      write(stream, offset);
+      write(stream, part.length);
+      write(stream, part.width);
+      write(stream, part.height);
+      offset += part.length;
+    }
+
+    std::vector<unsigned char> buffer;
+    for (auto& part : parts) {
+      buffer.resize(part.length);
+      if (part.packed) {
+        if (!pack::read(part.file.string(), buffer) || buffer.size() != part.length)
+          return false;
+      } else {
+        std::ifstream source(part.file, std::ios::binary);
+        if (!source.read(reinterpret_cast<char*>(buffer.data()), buffer.size()))
+          return false;
+      }
+      stream.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    }
+    return stream.good();
+  }
+
+  void closeAll()
+  {
+    for (auto fd : descriptors)
+      ::close(fd);
+    descriptors.clear();
+    entries.clear();
+    packStamp = 0;
+  }
+
+  // expects the unique lock
+  bool loadLocked(const std::vector<fs::path>& files)
+  {
+    closeAll();
+    loaded = true;
+
+    for (auto& file : files) {
+      std::ifstream stream(file, std::ios::binary);
+      char magic[sizeof(Magic)] = {};
+      uint32_t version          = 0;
+      uint32_t count            = 0;
+      if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 || !read(stream, version)
+          || version != Version || !read(stream, count))
+        continue;
+
+      std::error_code ec;
+      auto fileSize = fs::file_size(file, ec);
+      auto time     = fs::last_write_time(file, ec);
+      if (ec)
+        continue;
+
+      auto pack = static_cast<uint32_t>(descriptors.size());
+      std::vector<std::pair<std::string, Entry>> packed;
+      for (uint32_t i = 0; i < count; i++) {
+        std::string category, subcategory, name;
+        Entry entry { pack, 0, 0, 0, 0 };
+        if (!readString(stream, category) || !readString(stream, subcategory) || !readString(stream, name)
+            || !read(stream, entry.offset) || !read(stream, entry.length) || !read(stream, entry.width)
+            || !read(stream, entry.height) || entry.offset + entry.length > fileSize)
+          break;
+        packed.emplace_back(category + "/" + subcategory + "/" + name, entry);
+      }
+      if (packed.size() != count)
+        continue;
+
+      auto fd = ::open(file.string().c_str(), O_RDONLY);
+      if (fd < 0)
+        continue;
+
+      descriptors.push_back(fd);
+      for (auto& [key, entry] : packed)
+        entries[key] = entry;
+      packStamp = packStamp * 31 + static_cast<int64_t>(time.time_since_epoch().count()) + fileSize;
+    }
+
+    brls::sync([count = entries.size(), packs = descriptors.size()]() {
+      brls::Logger::info("Icon packs loaded: {} parts in {} packs", count, packs);
+    });
+    return !entries.empty();
+  }
+
+  bool loadLocked() { return loadLocked(packFiles()); }
+
+  void ensure()
+  {
+    {
+      std::shared_lock lock(mutex);
+      if (loaded)
+        return;
+    }
+    std::unique_lock lock(mutex);
+    if (!loaded)
+      loadLocked();
+  }
+
+  void removeLoose(const std::vector<Part>& parts)
+  {
+    std::error_code ec;
+    for (auto& part : parts) {
+      fs::remove(part.file, ec);
+      // only succeeds once the directory is empty
+      fs::remove(part.file.parent_path(), ec);
+      fs::remove(part.file.parent_path().parent_path(), ec);
+    }
+  }
+}
+
+bool build(const std::function<bool(const std::string&)>& current)
+{
+  auto parts = scan();
+  std::unordered_set<std::string> loose;
+  for (auto& part : parts)
+    loose.insert(partKey(part));
+
+  // packed parts the update kept, unless a loose file replaces them
+  size_t dropped = 0;
+  ensure();
+  {
+    std::shared_lock lock(mutex);
+    for (auto& [key, entry] : entries) {
+      auto path = std::string(paths::IconCachePath) + key;
+      if (loose.contains(key))
+        continue;
+      if (!current(path)) {
+        dropped++;
+        continue;
+      }
+
+      auto category = key.find('/');
+      auto name     = key.rfind('/');
+      parts.push_back({ key.substr(0, category), key.substr(category + 1, name - category - 1), key.substr(name + 1),
+          path, entry.length, entry.width, entry.height, true });
+    }
+  }
+
+  if (parts.empty())
+    return false;
+  if (loose.empty() && dropped == 0) {
+    brls::sync([]() { brls::Logger::info("Icon packs are up to date"); });
+    return true;
+  }
+
+  // parts of one subcategory end up next to each other, in the order the grids list them
+  std::sort(parts.begin(), parts.end(), sortParts);
+
+  std::error_code ec;
+  fs::create_directories(paths::PackPath, ec);
+
+  auto generation = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+  std::vector<fs::path> written;
+  for (size_t start = 0; start < parts.size();) {
+    uint64_t bytes = 0;
+    auto end       = start;
+    while (end < parts.size() && (end == start || bytes + parts[end].length <= PackCapacity))
+      bytes += parts[end++].length;
+
+    auto temp = fs::path(packFile(generation, written.size())).replace_extension(".tmp");
+    if (!writePack(temp, std::span(parts).subspan(start, end - start))) {
+      brls::sync([temp]() { brls::Logger::error("Failed to write icon pack {}", temp.string()); });
+      for (auto& file : written)
+        fs::remove(file, ec);
+      fs::remove(temp, ec);
+      return false;
+    }
+    written.push_back(temp);
+    start = end;
+  }
+
+  {
+    std::unique_lock lock(mutex);
+    auto previous = packFiles();
+    closeAll();
+
+    std::vector<fs::path> installed;
+    for (size_t i = 0; i < written.size(); i++) {
+      fs::rename(written[i], packFile(generation, i), ec);
+      if (ec)
+        break;
+      installed.push_back(packFile(generation, i));
+    }
+
+    // the old packs and the loose files are only dropped once every part can be served from the new packs
+    bool complete = installed.size() == written.size() && loadLocked(installed)
+        && std::all_of(parts.begin(), parts.end(), [](const Part& part) { return entries.contains(partKey(part)); });
+    if (!complete) {
+      brls::sync([]() { brls::Logger::error("Failed to install the icon packs; keeping the previous ones"); });
+      for (auto& file : written)
+        fs::remove(file, ec);
+      for (auto& file : installed)
+        fs::remove(file, ec);
+      loadLocked(previous);
+      return false;
+    }
+
+    for (auto& file : previous)
+      fs::remove(file, ec);
+  }
+
+  std::erase_if(parts, [](const Part& part) { return part.packed; });
+  removeLoose(parts);
+
+  brls::sync([count = parts.size(), dropped, packs = written.size()]() {
+    brls::Logger::info("Icon cache packed: {} new parts, {} dropped, {} packs", count, dropped, packs);
+  });
+  return true;
+}
+
+bool unpack(const std::function<bool(const std::string&)>& current)
+{
+  std::vector<std::string> keep;
+  ensure();
+  {
+    std::shared_lock lock(mutex);
+    for (auto& [key, entry] : entries) {
+      auto path = std::string(paths::IconCachePath) + key;
+      if (current(path))
+        keep.push_back(std::move(path));
+    }
+  }
+
+  size_t failed = 0;
+  std::vector<unsigned char> data;
+  for (auto& path : keep) {
+    // a loose file is what the update just wrote
+    std::error_code ec;
+    if (fs::exists(path, ec))
+      continue;
+
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!read(path, data) || !stream.write(reinterpret_cast<const char*>(data.data()), data.size())) {
+      stream.close();
+      fs::remove(path, ec);
+      failed++;
+    }
+  }
+
+  if (failed > 0)
+    brls::sync([failed]() { brls::Logger::error("Failed to unpack {} icon parts", failed); });
+  return failed == 0;
+}
+
+void clear()
+{
+  std::unique_lock lock(mutex);
+  closeAll();
+  loaded = true;
+
+  std::error_code ec;
+  for (auto& file : packFiles())
+    fs::remove(file, ec);
+}
+
+bool load()
+{
+  std::unique_lock lock(mutex);
+  return loadLocked();
+}
+
+bool available()
+{
+  ensure();
+  std::shared_lock lock(mutex);
+  return !entries.empty();
+}
+
+int64_t stamp()
+{
+  ensure();
+  std::shared_lock lock(mutex);
+  return packStamp;
+}
+
+bool read(const std::string& path, std::vector<unsigned char>& out)
+{
+  auto key = keyOf(path);
+  if (key.empty())
+    return false;
+
+  ensure();
+  std::shared_lock lock(mutex);
+  auto it = entries.find(key);
+  if (it == entries.end())
+    return false;
+
+  out.resize(it->second.length);
+  size_t done = 0;
+  while (done < out.size()) {
+    auto res = ::pread(descriptors[it->second.pack], out.data() + done, out.size() - done, it->second.offset + done);
+    if (res <= 0) {
+      out.clear();
+      return false;
+    }
+    done += res;
+  }
+  return true;
+}
+
+bool contains(const std::string& path)
+{
+  auto key = keyOf(path);
+  if (key.empty())
+    return false;
+
+  ensure();
+  std::shared_lock lock(mutex);
+  return entries.contains(key);
+}
+
+bool stat(const std::string& path, int64_t& mtime, uint64_t& size)
+{
+  auto key = keyOf(path);
+  if (key.empty())
+    return false;
+
+  ensure();
+  std::shared_lock lock(mutex);
+  auto it = entries.find(key);
+  if (it == entries.end())
+    return false;
+
+  mtime = packStamp;
+  size  = it->second.length;
+  return true;
+}
+
+void list(const std::function<void(const std::string&)>& visit)
+{
+  ensure();
+  std::shared_lock lock(mutex);
+  for (auto& [key, entry] : entries)
+    visit(std::string(paths::IconCachePath) + key);
+}
+}
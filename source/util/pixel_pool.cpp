@@ -0,0 +1,85 @@
+#include "util/pixel_pool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// large enough for shared_ptr's control block with an empty deleter and allocator
+constexpr size_t BlockSize = 64;
+
+struct PixelPool::Release {
+  void operator()(unsigned char* buffer) const { PixelPool::instance().release(buffer); }
+};
+
+template <typename T> struct PixelPool::BlockAllocator {
+  using value_type = T;
+
+  BlockAllocator() = default;
+  template <typename U> BlockAllocator(const BlockAllocator<U>&) { }
+
+  T* allocate(size_t n) { return static_cast<T*>(PixelPool::instance().allocateBlock(n * sizeof(T))); }
+  void deallocate(T* p, size_t n) { PixelPool::instance().releaseBlock(p, n * sizeof(T)); }
+
+  template <typename U> bool operator==(const BlockAllocator<U>&) const { return true; }
+};
+
+PixelPool::PixelPool()
+{
+  buffers.reserve(Capacity);
+  blocks.reserve(Capacity);
+}
+
+std::shared_ptr<unsigned char> PixelPool::acquire()
+{
+  unsigned char* buffer = nullptr;
+  {
+    std::lock_guard lock(mutex);
+    if (!buffers.empty()) {
+      buffer = buffers.back();
+      buffers.pop_back();
+    }
+  }
+
+  if (!buffer)
+    buffer = static_cast<unsigned char*>(std::malloc(BufferSize));
+  if (!buffer)
+    return nullptr;
+  return std::shared_ptr<unsigned char>(buffer, Release(), BlockAllocator<unsigned char>());
+}
+
+void PixelPool::release(unsigned char* buffer)
+{
+  {
+    std::lock_guard lock(mutex);
+    if (buffers.size() < Capacity) {
+      buffers.push_back(buffer);
+      return;
+    }
+  }
+  std::free(buffer);
+}
+
+void* PixelPool::allocateBlock(size_t size)
+{
+  if (size <= BlockSize) {
+    std::lock_guard lock(mutex);
+    if (!blocks.empty()) {
+      auto* block = blocks.back();
+      blocks.pop_back();
+      return block;
+    }
+  }
+  return ::operator new(std::max(size, BlockSize));
+}
+
+void PixelPool::releaseBlock(void* block, size_t size)
+{
+  if (size <= BlockSize) {
+    std::lock_guard lock(mutex);
+    if (blocks.size() < Capacity) {
+      blocks.push_back(block);
+      return;
+    }
+  }
+  ::operator delete(block);
+}
@@ -0,0 +1,72 @@
+#include "util/preview_pipeline.hpp"
+
+#include <borealis.hpp>
+#include <chrono>
+
+#include "util/layer_cache.hpp"
+
+// focus changes closer together than this are treated as one
+constexpr auto PreviewDebounce = std::chrono::milliseconds(30);
+
+PreviewPipeline::PreviewPipeline(const ImageState& state, Compose compose, Show show)
+    : state(state)
+    , compose(std::move(compose))
+    , show(std::move(show))
+    , worker([this](std::stop_token token) { run(token); })
+{
+}
+
+PreviewPipeline::~PreviewPipeline()
+{
+  // anything already queued on brls::sync is dropped
+  ++*generation;
+
+  auto stats = LayerCache::instance().stats();
+  brls::Logger::debug("Layer cache: {} hits, {} misses, {} evictions, {} layers in {} KiB", stats.hits, stats.misses,
+      stats.evictions, stats.entries, stats.bytes / 1024);
+}
+
+void PreviewPipeline::request(const std::string& path)
+{
+  {
+    std::lock_guard lock(mutex);
+    pending    = path;
+    hasPending = true;
+    ++*generation;
+  }
+  condition.notify_one();
+}
+
+void PreviewPipeline::run(std::stop_token token)
+{
+  while (!token.stop_requested()) {
+    std::string path;
+    uint64_t requested;
+    {
+      std::unique_lock lock(mutex);
+      if (!condition.wait(lock, token, [this]() { return hasPending; }))
+        return;
+
+      // wait for the focus to settle; every newer request restarts the wait
+      requested = *generation;
+      while (condition.wait_for(lock, token, PreviewDebounce, [&]() { return *generation != requested; }))
+        requested = *generation;
+      if (token.stop_requested())
+        return;
+
+      path       = std::move(pending);
+      hasPending = false;
+    }
+
+    compose(path, state);
+    if (*generation != requested)
+      continue;
+
+    // shared so the sync queue never copies the pixels
+    auto result = std::make_shared<Image>(state.working);
+    brls::sync([show = show, current = generation, requested, result]() {
+      if (*current == requested)
+        show(*result);
+    });
+  }
+}
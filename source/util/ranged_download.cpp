@@ -0,0 +1,260 @@
+#include "util/ranged_download.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+
+#include "extern/json.hpp"
+#include "util/curl_pool.hpp"
+
+using json   = nlohmann::ordered_json;
+namespace fs = std::filesystem;
+
+namespace ranged {
+
+namespace {
+  constexpr const char API_AGENT[] = "nso-icons";
+
+  size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userp)
+  {
+    auto* headers = static_cast<std::map<std::string, std::string>*>(userp);
+    std::string line(buffer, size * nitems);
+
+    // a redirect starts a new response
+    if (line.rfind("HTTP/", 0) == 0)
+      headers->clear();
+
+    auto colon = line.find(':');
+    if (colon != std::string::npos) {
+      auto name  = line.substr(0, colon);
+      auto value = line.substr(colon + 1);
+      std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+      value.erase(0, value.find_first_not_of(" \t"));
+      value.erase(value.find_last_not_of(" \t\r\n") + 1);
+      (*headers)[name] = value;
+    }
+    return size * nitems;
+  }
+
+  // the one byte of a 206; anything else is a server sending the whole file, which is cut off right here
+  size_t ProbeCallback(void* contents, size_t size, size_t nmemb, void* userp)
+  {
+    long status_code = 0;
+    curl_easy_getinfo(static_cast<CURL*>(userp), CURLINFO_RESPONSE_CODE, &status_code);
+    return status_code == 206 ? size * nmemb : 0;
+  }
+
+  size_t WriteRangeCallback(void* contents, size_t size, size_t nmemb, void* userp)
+  {
+    auto* range = static_cast<Range*>(userp);
+    if (range->cancelled && *range->cancelled)
+      return 0;
+
+    size_t realsize  = size * nmemb;
+    long status_code = 0;
+
+    // a 200 means If-Range failed and the whole (changed) file is coming
+    curl_easy_getinfo(range->curl, CURLINFO_RESPONSE_CODE, &status_code);
+    if (status_code != 206 || range->start + range->done + static_cast<int64_t>(realsize) > range->end + 1) {
+      range->stale = true;
+      return 0;
+    }
+
+    if (fwrite(contents, 1, realsize, range->file) != realsize)
+      return 0;
+    range->done += realsize;
+    return realsize;
+  }
+}
+
+bool probe(const std::string& url, Probe& res)
+{
+  CurlPool::Handle curl;
+  std::map<std::string, std::string> headers;
+  long status_code = 0;
+  char* effective  = nullptr;
+
+  if (!curl)
+    return false;
+
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, API_AGENT);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+  curl_easy_setopt(curl, CURLOPT_RANGE, "0-0");
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headers);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ProbeCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, static_cast<CURL*>(curl));
+  // CURLE_WRITE_ERROR is the callback refusing a response that is not a range
+  if (curl_easy_perform(curl) != CURLE_OK)
+    return false;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
+  curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective);
+
+  auto range = headers["content-range"];
+  auto slash = range.rfind('/');
+  if (status_code != 206 || slash == std::string::npos)
+    return false;
+
+  res.url       = effective ? effective : url;
+  res.size      = std::strtoll(range.c_str() + slash + 1, nullptr, 10);
+  res.validator = headers.count("etag") ? headers["etag"] : headers["last-modified"];
+  return res.size > 0;
+}
+
+std::string statePath(const std::string& output) { return output + ".state"; }
+
+void saveState(const std::string& output, const std::string& url, const Probe& info, const std::vector<Range>& ranges)
+{
+  json state = { { "url", url }, { "validator", info.validator }, { "size", info.size }, { "ranges", json::array() } };
+  for (auto& range : ranges)
+    state["ranges"].push_back({ range.start, range.end, range.done });
+
+  std::ofstream stream(statePath(output), std::ios::trunc);
+  stream << state;
+}
+
+std::vector<Range> loadState(const std::string& output, const std::string& url, const Probe& info)
+{
+  std::vector<Range> ranges;
+  std::error_code ec;
+  if (fs::file_size(output, ec) != static_cast<uintmax_t>(info.size) || ec)
+    return ranges;
+
+  try {
+    std::ifstream stream(statePath(output));
+    auto state = json::parse(stream);
+    if (state["url"] != url || state["validator"] != info.validator || state["size"] != info.size)
+      return ranges;
+
+    for (auto& saved : state["ranges"]) {
+      auto& range = ranges.emplace_back();
+      range.start = saved[0];
+      range.end   = saved[1];
+      range.done  = saved[2];
+    }
+  } catch (const std::exception& e) {
+    ranges.clear();
+  }
+  return ranges;
+}
+
+std::vector<Range> split(int64_t size, int connections)
+{
+  std::vector<Range> ranges;
+  int64_t slice = (size + connections - 1) / connections;
+  for (int64_t start = 0; start < size; start += slice) {
+    auto& range = ranges.emplace_back();
+    range.start = start;
+    range.end   = std::min(start + slice, size) - 1;
+  }
+  return ranges;
+}
+
+bool createFile(const std::string& output, int64_t size)
+{
+  std::error_code ec;
+  fs::remove(output, ec);
+  {
+    std::ofstream stream(output, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open())
+      return false;
+  }
+  fs::resize_file(output, size, ec);
+  return !ec;
+}
+
+int64_t received(const std::vector<Range>& ranges)
+{
+  int64_t res = 0;
+  for (auto& range : ranges)
+    res += range.done;
+  return res;
+}
+
+bool complete(const std::vector<Range>& ranges)
+{
+  return std::all_of(
+      ranges.begin(), ranges.end(), [](const Range& range) { return range.start + range.done > range.end; });
+}
+
+bool fetch(const std::string& url, const std::string& output, const Probe& info, std::vector<Range>& ranges,
+    const std::function<bool(int64_t, int64_t)>& progress)
+{
+  CURLM* multi = curl_multi_init();
+  std::vector<std::unique_ptr<CurlPool::Handle>> handles;
+  struct curl_slist* headers = nullptr;
+  bool cancelled             = false;
+  if (!info.validator.empty())
+    headers = curl_slist_append(headers, fmt::format("If-Range: {}", info.validator).c_str());
+
+  for (auto& range : ranges) {
+    if (range.start + range.done > range.end || !(range.file = fopen(output.c_str(), "r+b")))
+      continue;
+    fseek(range.file, range.start + range.done, SEEK_SET);
+
+    range.curl      = *handles.emplace_back(std::make_unique<CurlPool::Handle>());
+    range.cancelled = &cancelled;
+    auto bytes      = fmt::format("{}-{}", range.start + range.done, range.end);
+    curl_easy_setopt(range.curl, CURLOPT_URL, info.url.c_str());
+    curl_easy_setopt(range.curl, CURLOPT_USERAGENT, API_AGENT);
+    curl_easy_setopt(range.curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(range.curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(range.curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(range.curl, CURLOPT_RANGE, bytes.c_str());
+    curl_easy_setopt(range.curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(range.curl, CURLOPT_WRITEFUNCTION, WriteRangeCallback);
+    curl_easy_setopt(range.curl, CURLOPT_WRITEDATA, &range);
+    // a dropped connection otherwise hangs until the OS gives up on it
+    curl_easy_setopt(range.curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(range.curl, CURLOPT_LOW_SPEED_TIME, 30L);
+    curl_multi_add_handle(multi, range.curl);
+  }
+
+  auto saved  = std::chrono::steady_clock::now();
+  int running = 0;
+  do {
+    curl_multi_perform(multi, &running);
+    if (running)
+      curl_multi_poll(multi, nullptr, 0, 500, nullptr);
+
+    if (!progress(info.size, received(ranges)))
+      cancelled = true;
+    if (std::chrono::steady_clock::now() - saved > std::chrono::seconds(1)) {
+      for (auto& range : ranges) {
+        if (range.file)
+          fflush(range.file);
+      }
+      saveState(output, url, info, ranges);
+      saved = std::chrono::steady_clock::now();
+    }
+  } while (running);
+
+  bool stale = false;
+  for (auto& range : ranges) {
+    if (range.curl)
+      curl_multi_remove_handle(multi, range.curl);
+    if (range.file)
+      fclose(range.file);
+    stale           = stale || range.stale;
+    range.curl      = nullptr;
+    range.file      = nullptr;
+    range.stale     = false;
+    range.cancelled = nullptr;
+  }
+  handles.clear();
+  curl_multi_cleanup(multi);
+  curl_slist_free_all(headers);
+
+  saveState(output, url, info, ranges);
+  return !stale;
+}
+}
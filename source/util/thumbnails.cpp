@@ -0,0 +1,330 @@
+#include "util/thumbnails.hpp"
+
+#include <fmt/format.h>
+#include <xxhash.h>
+
+#include <borealis.hpp>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "extern/json.hpp"
+#include "util/pack.hpp"
+#include "util/paths.hpp"
+
+namespace fs = std::filesystem;
+
+namespace thumbnails {
+
+namespace {
+  constexpr char Magic[4]    = { 'N', 'S', 'O', 'T' };
+  constexpr uint32_t Version = 1;
+  // rewrite a container once half of it, and at least this many bytes, belong to replaced or deleted sources
+  constexpr uint64_t CompactThreshold = 0x40000;
+
+  struct Entry {
+    int64_t mtime;
+    uint64_t size;
+    uint64_t offset;
+    uint32_t length;
+  };
+
+  struct Container {
+    fs::path file;
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t dead = 0; // bytes taken by records no entry points at
+  };
+
+  std::mutex mutex;
+  std::string stamp;
+  bool stampLoaded = false;
+  std::unordered_map<std::string, Container> containers; // keyed by source directory
+
+  template <typename T> bool read(std::ifstream& stream, T& value)
+  {
+    return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+  }
+
+  template <typename T> void write(std::ofstream& stream, T value)
+  {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  const std::string& currentStamp()
+  {
+    if (!stampLoaded) {
+      stampLoaded = true;
+      try {
+        std::ifstream stream(std::string(paths::CacheFilePath));
+        auto json = nlohmann::json::parse(stream);
+        if (json.contains("updateSha"))
+          stamp = json["updateSha"];
+      } catch (const std::exception& e) {
+        stamp.clear();
+      }
+    }
+    return stamp;
+  }
+
+  uint64_t headerSize() { return sizeof(Magic) + sizeof(uint32_t) + sizeof(uint16_t) + currentStamp().size(); }
+
+  // the PNG follows this record header
+  uint64_t recordHeaderSize(const std::string& name)
+  {
+    return sizeof(uint16_t) + name.size() + sizeof(int64_t) + sizeof(uint64_t) + sizeof(uint32_t);
+  }
+
+  void writeHeader(std::ofstream& stream)
+  {
+    stream.write(Magic, sizeof(Magic));
+    write(stream, Version);
+    write(stream, static_cast<uint16_t>(currentStamp().size()));
+    stream.write(currentStamp().data(), currentStamp().size());
+  }
+
+  void writeRecord(std::ofstream& stream, const std::string& name, const Entry& entry, const char* data)
+  {
+    write(stream, static_cast<uint16_t>(name.size()));
+    stream.write(name.data(), name.size());
+    write(stream, entry.mtime);
+    write(stream, entry.size);
+    write(stream, entry.length);
+    stream.write(data, entry.length);
+  }
+
+  // runs on decode workers, so nothing here may throw
+  void reset(Container& container)
+  {
+    container.entries.clear();
+    container.dead = 0;
+
+    std::error_code ec;
+    fs::create_directories(container.file.parent_path(), ec);
+
+    std::ofstream stream(container.file, std::ios::binary | std::ios::trunc);
+    writeHeader(stream);
+  }
+
+  bool wasteful(const Container& container, uint64_t fileSize)
+  {
+    return container.dead >= CompactThreshold && container.dead * 2 >= fileSize;
+  }
+
+  // rewrites the container with only the records its entries point at
+  void compact(Container& container)
+  {
+    auto temp = fs::path(container.file).replace_extension(".tmp");
+    std::unordered_map<std::string, Entry> entries;
+    {
+      std::ifstream source(container.file, std::ios::binary);
+      std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+      writeHeader(stream);
+
+      uint64_t offset = headerSize();
+      std::vector<char> buffer;
+      for (auto& [name, entry] : container.entries) {
+        buffer.resize(entry.length);
+        if (!source.seekg(entry.offset) || !source.read(buffer.data(), buffer.size()))
+          continue;
+
+        writeRecord(stream, name, entry, buffer.data());
+        offset += recordHeaderSize(name);
+        entries[name] = Entry { entry.mtime, entry.size, offset, entry.length };
+        offset += entry.length;
+      }
+
+      if (!stream.good()) {
+        stream.close();
+        std::error_code ec;
+        fs::remove(temp, ec);
+        return;
+      }
+    }
+
+    // rename does not replace an existing file on the Switch's fsdev
+    std::error_code ec;
+    fs::remove(container.file, ec);
+    fs::rename(temp, container.file, ec);
+    if (ec) {
+      reset(container);
+      return;
+    }
+
+    brls::sync([file = container.file.string(), dead = container.dead]() {
+      brls::Logger::debug("Compacted thumbnails {}: {} bytes dropped", file, dead);
+    });
+    container.entries = std::move(entries);
+    container.dead    = 0;
+  }
+
+  Container& open(const std::string& directory)
+  {
+    if (auto it = containers.find(directory); it != containers.end())
+      return it->second;
+
+    auto& container = containers[directory];
+    container.file  = fs::path(paths::ThumbnailPath)
+        / fmt::format("{:016x}.bin", XXH3_64bits(directory.data(), directory.size()));
+
+    std::ifstream stream(container.file, std::ios::binary);
+    char magic[sizeof(Magic)] = {};
+    uint32_t version          = 0;
+    uint16_t length           = 0;
+    std::string fileStamp;
+
+    if (!stream.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 || !read(stream, version)
+        || version != Version || !read(stream, length)) {
+      stream.close();
+      reset(container);
+      return container;
+    }
+
+    fileStamp.resize(length);
+    if (!stream.read(fileStamp.data(), length) || fileStamp != currentStamp()) {
+      stream.close();
+      reset(container);
+      return container;
+    }
+
+    // records are appended; a later record for the same name wins and the earlier one is dead
+    std::error_code ec;
+    auto fileSize = fs::file_size(container.file, ec);
+    auto good     = static_cast<uint64_t>(stream.tellg());
+    for (;;) {
+      uint16_t nameLength;
+      std::string name;
+      Entry entry;
+      if (!read(stream, nameLength))
+        break;
+      name.resize(nameLength);
+      if (!stream.read(name.data(), nameLength) || !read(stream, entry.mtime) || !read(stream, entry.size)
+          || !read(stream, entry.length))
+        break;
+
+      entry.offset = static_cast<uint64_t>(stream.tellg());
+      if (entry.offset + entry.length > fileSize || !stream.seekg(entry.length, std::ios::cur))
+        break;
+
+      if (auto it = container.entries.find(name); it != container.entries.end())
+        container.dead += recordHeaderSize(name) + it->second.length;
+      container.entries[name] = entry;
+      good                    = entry.offset + entry.length;
+    }
+    stream.close();
+
+    // drop a record that was only partially written
+    if (!ec && fileSize != good)
+      fs::resize_file(container.file, good, ec);
+
+    // sources deleted since (removed collection icons); packed directories have nothing to list and are skipped
+    std::unordered_set<std::string> present;
+    fs::directory_iterator it(directory, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec))
+      present.insert(it->path().filename().string());
+    if (!ec) {
+      std::erase_if(container.entries, [&](const auto& item) {
+        if (present.contains(item.first))
+          return false;
+        container.dead += recordHeaderSize(item.first) + item.second.length;
+        return true;
+      });
+    }
+
+    if (wasteful(container, good))
+      compact(container);
+    return container;
+  }
+
+  bool stat(const fs::path& path, int64_t& mtime, uint64_t& size)
+  {
+    if (pack::stat(path.string(), mtime, size))
+      return true;
+
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    if (ec)
+      return false;
+    size = fs::file_size(path, ec);
+    if (ec)
+      return false;
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+  }
+}
+
+Image load(const std::string& path, int size)
+{
+  auto source    = fs::path(path);
+  auto directory = source.parent_path().string();
+  auto name      = source.filename().string();
+
+  int64_t mtime  = 0;
+  uint64_t bytes = 0;
+  if (!stat(source, mtime, bytes))
+    return Image();
+
+  std::vector<unsigned char> png;
+  {
+    std::lock_guard lock(mutex);
+    auto& container = open(directory);
+    if (auto it = container.entries.find(name);
+        it != container.entries.end() && it->second.mtime == mtime && it->second.size == bytes) {
+      std::ifstream stream(container.file, std::ios::binary);
+      png.resize(it->second.length);
+      if (!stream.seekg(it->second.offset) || !stream.read(reinterpret_cast<char*>(png.data()), png.size()))
+        png.clear();
+    }
+  }
+
+  if (!png.empty()) {
+    Image thumbnail(png.data(), png.size());
+    if (thumbnail.data && thumbnail.x == size && thumbnail.y == size)
+      return thumbnail;
+  }
+
+  Image image(path, size, size);
+  if (!image.data)
+    return image;
+
+  png.clear();
+  if (!image.encodePng(png, Image::PngEncoder::FAST))
+    return image;
+
+  std::lock_guard lock(mutex);
+  auto& container = open(directory);
+
+  std::error_code ec;
+  auto offset = fs::file_size(container.file, ec);
+  if (ec)
+    return image;
+
+  Entry entry { mtime, bytes, offset + recordHeaderSize(name), static_cast<uint32_t>(png.size()) };
+  {
+    std::ofstream stream(container.file, std::ios::binary | std::ios::app);
+    writeRecord(stream, name, entry, reinterpret_cast<const char*>(png.data()));
+    if (!stream.good())
+      return image;
+  }
+
+  if (auto it = container.entries.find(name); it != container.entries.end())
+    container.dead += recordHeaderSize(name) + it->second.length;
+  container.entries[name] = entry;
+
+  if (wasteful(container, entry.offset + entry.length))
+    compact(container);
+  return image;
+}
+
+void setStamp(const std::string& value)
+{
+  std::lock_guard lock(mutex);
+  stamp       = value;
+  stampLoaded = true;
+  containers.clear();
+}
+}
@@ -4,10 +4,15 @@
 #include <filesystem>
 #include <vector>
 
+#include "util/thumbnails.hpp"
+
 using namespace brls::literals; // for _i18n
 
 using namespace collection;
 
+// alpha of an item marked for deletion
+constexpr float SelectedAlpha = 0.15f;
+
 RecyclerCell::RecyclerCell()
 {
   this->inflateFromXMLRes("xml/cells/icon_part_cell_grid.xml");
@@ -37,16 +42,55 @@ void RecyclerCell::onFocusGained()
   cb(img);
 }
 
+void RecyclerCell::draw(
+    NVGcontext* vg, float x, float y, float width, float height, brls::Style style, brls::FrameContext* ctx)
+{
+  if (loading)
+    SkeletonCell::drawSkeleton(vg, x, y, width, height, brls::Application::getTheme()["color/grey_3"], getAlpha());
+
+  RecyclingGridItem::draw(vg, x, y, width, height, style, ctx);
+}
+
+void RecyclerCell::load(const std::string& path, size_t index, std::function<void(Image&&)> onLoaded)
+{
+  loading         = true;
+  auto generation = ticket->load();
+
+  ASYNC_RETAIN
+  auto done = [ASYNC_TOKEN, index, generation, onLoaded](Image&& decoded) {
+    ASYNC_RELEASE
+    if (*ticket != generation || getIndex() != index)
+      return;
+
+    loading = false;
+    if (!decoded.data)
+      return;
+
+    image->setImageFromMemRGBA(decoded.data.get(), decoded.x, decoded.y);
+    if (onLoaded)
+      onLoaded(std::move(decoded));
+  };
+  DecodePool::instance().request(path, ticket, done, thumbnails::Size);
+}
+
 RecyclingGridItem* DataSource::cellForRow(RecyclingGrid* recycler, size_t index)
 {
   RecyclerCell* item = (RecyclerCell*)recycler->dequeueReusableCell("Cell");
   brls::Logger::debug("image: {}", items[index].file);
 
   if (items[index].image.data.get() == nullptr) {
-    items[index].image = Image(items[index].file);
+    // the cell outlives a cleared or replaced data source; the generation says whether items is still the same
+    auto expected = generation->load();
+    item->load(items[index].file, index, [this, index, alive = generation, expected](Image&& decoded) {
+      if (*alive != expected)
+        return;
+      decoded.displayAlpha = items[index].image.displayAlpha;
+      items[index].image   = std::move(decoded);
+    });
+  } else {
+    item->image->setImageFromMemRGBA(items[index].image.data.get(), items[index].image.x, items[index].image.y);
   }
-
-  item->image->setImageFromMemRGBA(items[index].image.data.get(), items[index].image.x, items[index].image.y);
+  item->image->setAlpha(items[index].image.displayAlpha);
   item->img = items[index].file;
   return item;
 }
@@ -63,17 +107,32 @@ void DataSource::onItemSelected(RecyclingGrid* recycler, size_t index)
   }
 }
 
+void DataSource::prefetchRows(RecyclingGrid* recycler, const std::vector<size_t>& indexes)
+{
+  std::vector<std::string> paths;
+  for (auto index : indexes) {
+    // items keep their image once shown, so only the ones never loaded need decoding
+    if (!items[index].image.data)
+      paths.push_back(items[index].file);
+  }
+  DecodePool::instance().prefetch(std::move(paths), thumbnails::Size);
+}
+
 void DataSource::updateCell(RecyclingGridItem* item, size_t index)
 {
+  // only the alpha changes here; the texture was uploaded by cellForRow or the decode callback, if it is ready yet
   auto cell = dynamic_cast<RecyclerCell*>(item);
-  if (cell) {
-    cell->image->setImageFromMemRGBA(items[index].image.data.get(), items[index].image.x, items[index].image.y);
-  }
+  if (cell)
+    cell->image->setAlpha(items[index].image.displayAlpha);
 }
 
 size_t DataSource::getItemCount() { return items.size(); }
 
-void DataSource::clearData() { items.clear(); }
+void DataSource::clearData()
+{
+  ++*generation;
+  items.clear();
+}
 
 bool DataSource::onItemAction(RecyclingGrid* recycler, size_t index, brls::ControllerButton button)
 {
@@ -82,11 +141,8 @@ bool DataSource::onItemAction(RecyclingGrid* recycler, size_t index, brls::Contr
   if (button == brls::ControllerButton::BUTTON_X) {
     select                = !items[index].selected;
     items[index].selected = select;
-    if (select) {
-      items[index].image.applyAlpha(0.15f);
-    } else {
-      items[index].image = Image(items[index].file);
-    }
+    // dimmed through the view's alpha; the decoded pixels stay as they are
+    items[index].image.displayAlpha = select ? SelectedAlpha : 1.0f;
 
     auto anySelected = std::any_of(items.begin(), items.end(), [](CollectionItem& v) { return v.selected; });
 
@@ -107,6 +163,8 @@ DataSource::DataSource(
 {
 }
 
+DataSource::~DataSource() { ++*generation; }
+
 void DataSource::deleteSelected()
 {
   for (auto& item : items) {
@@ -129,11 +187,11 @@ CollectionGrid::CollectionGrid(const std::vector<std::string>& files, std::strin
   }
 
   workingImage->setImageFromMemRGBA(state.working.data.get(), state.working.x, state.working.y);
-  recycler->registerCell("Cell", [view = workingImage.getView(), &state, onFocused]() {
-    return RecyclerCell::create([view, &state, onFocused](std::string path) {
-      onFocused(path, state);
-      view->setImageFromMemRGBA(state.working.data.get(), state.working.x, state.working.y);
-    });
+  preview = std::make_unique<PreviewPipeline>(state, onFocused, [view = workingImage.getView()](const Image& working) {
+    view->setImageFromMemRGBA(working.data.get(), working.x, working.y);
+  });
+  recycler->registerCell("Cell", [preview = preview.get()]() {
+    return RecyclerCell::create([preview](std::string path) { preview->request(path); });
   });
   auto* data = new collection::DataSource(std::move(items), onSelected, this);
   recycler->setDataSource(data);
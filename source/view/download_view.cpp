@@ -5,26 +5,39 @@
 #include <filesystem>
 #include <regex>
 
+#include "util/catalog.hpp"
 #include "util/download.hpp"
 #include "util/extract.hpp"
+#include "util/manifest.hpp"
+#include "util/pack.hpp"
+#include "util/paths.hpp"
 #include "util/progress_event.hpp"
+#include "util/ring_buffer.hpp"
 
 using namespace brls::literals;
 
+// enough to ride out a slow SD write without stalling the connection
+constexpr size_t StreamBufferSize = 0x400000;
+constexpr int DownloadConnections = 4;
+
 DownloadView::DownloadView(std::string url, std::string downloadPath, std::string extractPath, bool overwriteExisting,
-    DownloadDoneEvent::Callback cb)
+    bool packIcons, DownloadDoneEvent::Callback cb)
     : url(url)
     , downloadPath(downloadPath)
     , extractPath(extractPath)
     , overwriteExisting(overwriteExisting)
     , cb(cb)
+    , packIcons(packIcons)
 {
   this->inflateFromXMLRes("xml/views/download_view.xml");
 
   ProgressEvent::instance().reset();
 
   download_text->setText(url);
-  extract_text->setText(fmt::format(fmt::runtime("app/download/path_to_path"_i18n), downloadPath, extractPath));
+  if (downloadPath.empty())
+    extract_text->setText(extractPath);
+  else
+    extract_text->setText(fmt::format(fmt::runtime("app/download/path_to_path"_i18n), downloadPath, extractPath));
 
   status_current->setText("");
   status_percent->setText("");
@@ -47,96 +60,211 @@ void DownloadView::downloadFile()
     std::unique_lock<std::mutex> lock(threadMutex);
   }
 
+  if (downloadPath.empty()) {
+    streamFile();
+    return;
+  }
+
   brls::Logger::info("Download started: {} to {}", url, downloadPath);
   ProgressEvent::instance().reset();
-  std::filesystem::remove(downloadPath);
-  download::downloadFile(url, downloadPath);
+  auto status = download::downloadResumable(url, downloadPath, DownloadConnections);
   brls::Logger::info("Download complete");
   downloadFinished.test_and_set();
 
   ProgressEvent::instance().reset();
 
-  brls::Logger::info("Extract started: {} to {}", downloadPath, extractPath);
-  extract::extract(downloadPath, extractPath, overwriteExisting);
-  brls::Logger::info("Extract complete");
+  // an unfinished archive stays on the card so the next attempt picks it up where it stopped
+  if (status == 200 || status == 206) {
+    brls::Logger::info("Extract started: {} to {}", downloadPath, extractPath);
+    catalog::Builder index;
+    manifest::Manifest manifest(paths::ManifestPath);
+    if (manifest.load())
+      brls::Logger::info("Loaded manifest {} ({} entries)", paths::ManifestPath, manifest.size());
+    bool extracted = extract::extract(downloadPath, extractPath, overwriteExisting,
+        [&index](const std::filesystem::path& file) { index.add(file); }, &manifest, packedExists());
+    std::filesystem::remove(downloadPath);
+    if (extracted && finishExtract(index)) {
+      brls::Logger::info("Extract complete");
+    } else {
+      brls::Logger::error("Extract failed; the update stays pending");
+      error = "app/errors/extract_failed"_i18n;
+    }
+  } else {
+    brls::Logger::error("Download failed ({}); keeping {} to resume later", status, downloadPath);
+    error = "app/errors/download_failed"_i18n;
+  }
   extractFinished.test_and_set();
 
-  cb("");
+  cb(error);
 }
 
-void DownloadView::updateProgress()
+void DownloadView::streamFile()
 {
-  {
-    std::unique_lock<std::mutex> lock(threadMutex);
+  brls::Logger::info("Streaming download started: {} into {}", url, extractPath);
+  ProgressEvent::instance().reset();
+
+  RingBuffer pipe(StreamBufferSize);
+  catalog::Builder index;
+  manifest::Manifest manifest(paths::ManifestPath);
+  if (manifest.load())
+    brls::Logger::info("Loaded manifest {} ({} entries)", paths::ManifestPath, manifest.size());
+  bool extracted = false;
+  std::jthread extractThread([this, &pipe, &index, &manifest, &extracted]() {
+    extracted = extract::extract(pipe, extractPath, overwriteExisting,
+        [&index](const std::filesystem::path& file) { index.add(file); }, &manifest, packedExists());
+  });
+
+  auto status = download::downloadStream(url, pipe);
+  brls::Logger::info("Download complete");
+  downloadFinished.test_and_set();
+
+  extractThread.join();
+  // a failed or truncated stream leaves a partial cache; the update stays pending so it is offered again
+  if (status != 200 && status != 206) {
+    brls::Logger::error("Streaming download failed ({})", status);
+    error = "app/errors/download_failed"_i18n;
+  } else if (!extracted || !finishExtract(index)) {
+    brls::Logger::error("Extract failed; the update stays pending");
+    error = "app/errors/extract_failed"_i18n;
+  } else {
+    brls::Logger::info("Extract complete");
   }
-  // DOWNLOAD
-  {
-    ASYNC_RETAIN
-    brls::sync([ASYNC_TOKEN]() {
-      ASYNC_RELEASE
-      download_status->setText("app/download/downloading"_i18n);
-      extract_status->setText("app/download/waiting"_i18n);
-    });
+  extractFinished.test_and_set();
 
-    while (ProgressEvent::instance().getTotal() == 0) {
-      if (downloadFinished.test())
-        break;
-      std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    }
-    while (!downloadFinished.test()) {
-      ASYNC_RETAIN
-      brls::sync([ASYNC_TOKEN]() {
-        ASYNC_RELEASE
-        this->status_current->setText(fmt::format("{:.0f}MB ({:.1f}MB/s)",
-            ProgressEvent::instance().getNow() / 1000000.0, ProgressEvent::instance().getSpeed() / 1000000.0));
-      });
-      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  cb(error);
+}
+
+std::function<bool(const std::filesystem::path&)> DownloadView::packedExists()
+{
+  // without packing the parts have to be loose again, so packed ones count as missing and get written out
+  if (!packIcons)
+    return nullptr;
+  return [](const std::filesystem::path& file) {
+    return std::filesystem::exists(file) || pack::contains(file.string());
+  };
+}
+
+bool DownloadView::finishExtract(catalog::Builder& index)
+{
+  if (ProgressEvent::instance().getInterupt())
+    return false;
+
+  auto current = [&index](const std::string& path) { return index.contains(path); };
+
+  // packs left from an earlier update would shadow the files just extracted; what the update skipped because it was
+  // packed comes out first
+  if (!packIcons || !pack::build(current)) {
+    if (!pack::unpack(current)) {
+      // the manifest would keep skipping the parts that did not come out
+      std::error_code ec;
+      std::filesystem::remove(paths::ManifestPath, ec);
+      brls::Logger::error("Keeping the icon packs; the next update extracts in full");
+      return false;
     }
+    pack::clear();
   }
-  // EXTRACT
-  {
+  index.write();
+  return true;
+}
+
+void DownloadView::updateStreamProgress()
+{
+  ASYNC_RETAIN
+  brls::sync([ASYNC_TOKEN]() {
+    ASYNC_RELEASE
+    download_status->setText("app/download/downloading"_i18n);
+    extract_status->setText("app/download/extracting"_i18n);
+  });
+
+  while (!extractFinished.test()) {
     ASYNC_RETAIN
     brls::sync([ASYNC_TOKEN]() {
       ASYNC_RELEASE
-      download_status->setText("app/download/downloaded"_i18n);
-      extract_status->setText("app/download/extracting"_i18n);
-      status_current->setText("");
+      if (downloadFinished.test())
+        download_status->setText("app/download/downloaded"_i18n);
+      this->status_current->setText(fmt::format(fmt::runtime("app/download/streaming"_i18n),
+          ProgressEvent::instance().getNow() / 1000000.0, ProgressEvent::instance().getSpeed() / 1000000.0,
+          ProgressEvent::instance().getFiles()));
     });
-    while (ProgressEvent::instance().getMax() == 0) {
-      if (extractFinished.test())
-        break;
-      std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+}
+
+void DownloadView::updateProgress()
+{
+  {
+    std::unique_lock<std::mutex> lock(threadMutex);
+  }
 
-    while (ProgressEvent::instance().getStep() < ProgressEvent::instance().getMax() && !extractFinished.test()) {
+  if (downloadPath.empty()) {
+    updateStreamProgress();
+  } else {
+    // DOWNLOAD
+    {
       ASYNC_RETAIN
       brls::sync([ASYNC_TOKEN]() {
         ASYNC_RELEASE
-
-        this->status_current->setText(
-            fmt::format("{}/{}", ProgressEvent::instance().getStep(), ProgressEvent::instance().getMax()));
-        this->status_percent->setText(fmt::format(
-            "({}%)", (int)((ProgressEvent::instance().getStep() * 100 / ProgressEvent::instance().getMax()))));
+        download_status->setText("app/download/downloading"_i18n);
+        extract_status->setText("app/download/waiting"_i18n);
       });
-      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+      while (ProgressEvent::instance().getTotal() == 0) {
+        if (downloadFinished.test())
+          break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      }
+      while (!downloadFinished.test()) {
+        ASYNC_RETAIN
+        brls::sync([ASYNC_TOKEN]() {
+          ASYNC_RELEASE
+          this->status_current->setText(fmt::format("{:.0f}MB ({:.1f}MB/s)",
+              ProgressEvent::instance().getNow() / 1000000.0, ProgressEvent::instance().getSpeed() / 1000000.0));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      }
     }
+    // EXTRACT
     {
       ASYNC_RETAIN
       brls::sync([ASYNC_TOKEN]() {
         ASYNC_RELEASE
-        this->status_spinner->animate(false);
-        this->status_spinner->setVisibility(brls::Visibility::INVISIBLE);
-        this->status_current->setText("");
-        this->status_percent->setText("");
-        extract_status->setText("app/download/extracted"_i18n);
+        download_status->setText("app/download/downloaded"_i18n);
+        extract_status->setText("app/download/extracting"_i18n);
+        status_current->setText("");
       });
+      while (ProgressEvent::instance().getMax() == 0) {
+        if (extractFinished.test())
+          break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      }
+
+      while (ProgressEvent::instance().getStep() < ProgressEvent::instance().getMax() && !extractFinished.test()) {
+        ASYNC_RETAIN
+        brls::sync([ASYNC_TOKEN]() {
+          ASYNC_RELEASE
+
+          this->status_current->setText(
+              fmt::format("{}/{}", ProgressEvent::instance().getStep(), ProgressEvent::instance().getMax()));
+          this->status_percent->setText(fmt::format(
+              "({}%)", (int)((ProgressEvent::instance().getStep() * 100 / ProgressEvent::instance().getMax()))));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      }
     }
   }
-  // CLEANUP
+  // DONE
   {
-    std::filesystem::remove(downloadPath);
+    ASYNC_RETAIN
+    brls::sync([ASYNC_TOKEN]() {
+      ASYNC_RELEASE
+      this->status_spinner->animate(false);
+      this->status_spinner->setVisibility(brls::Visibility::INVISIBLE);
+      this->status_current->setText(error);
+      this->status_percent->setText("");
+      download_status->setText("app/download/downloaded"_i18n);
+      extract_status->setText("app/download/extracted"_i18n);
+    });
   }
-
   // Add a button to go back after the end of the download
   ASYNC_RETAIN
   brls::sync([ASYNC_TOKEN]() {
@@ -2,9 +2,12 @@
 #include "view/icon_part_select.hpp"
 
 #include <filesystem>
+#include <optional>
 #include <ranges>
 #include <vector>
 
+#include "util/catalog.hpp"
+#include "util/pack.hpp"
 #include "util/paths.hpp"
 #include "view/empty_message.hpp"
 #include "view/icon_part_select_grid.hpp"
@@ -36,6 +39,18 @@ std::string convertName(std::string name)
   return name;
 }
 
+// the ImageState layer a subcategory's parts replace
+std::optional<ImageState::Layer> layerOf(std::string_view subcategory)
+{
+  if (subcategory == "frames")
+    return ImageState::FRAME;
+  if (subcategory == "characters")
+    return ImageState::CHARACTER;
+  if (subcategory == "backgrounds")
+    return ImageState::BACKGROUND;
+  return std::nullopt;
+}
+
 RecyclingGridItem* DataSource::cellForRow(RecyclingGrid* recycler, size_t index)
 {
   RecyclerCell* item = (RecyclerCell*)recycler->dequeueReusableCell("Cell");
@@ -46,7 +61,12 @@ RecyclingGridItem* DataSource::cellForRow(RecyclingGrid* recycler, size_t index)
   } else {
     item->label->setText(convertName(parts[index].name));
   }
-  item->image->setImageFromFile(parts[index].icon);
+  // category icons of a packed cache have no file of their own
+  std::vector<unsigned char> png;
+  if (pack::read(parts[index].icon, png))
+    item->image->setImageFromMem(png.data(), png.size());
+  else
+    item->image->setImageFromFile(parts[index].icon);
   return item;
 }
 
@@ -84,17 +104,10 @@ void DataSource::onItemSelected(RecyclingGrid* recycler, size_t index)
               parent->dismiss();
             }
           },
-          onFocused));
+          onFocused, layerOf(subcategory)));
     }
   } else {
-    auto files = std::ranges::subrange(
-                     fs::directory_iterator(fs::path(paths::IconCachePath) / parts[index].name / subcategory),
-                     fs::directory_iterator {})
-        | std::views::filter([](const fs::directory_entry& entry) {
-            return entry.is_regular_file() && entry.path().extension() == ".png";
-          })
-        | std::views::transform([](const fs::directory_entry& entry) { return entry.path().string(); })
-        | std::ranges::to<std::vector<std::string>>();
+    auto files = catalog::parts(parts[index].name, subcategory);
 
     for (auto& file : files) {
       brls::Logger::debug("{}", file);
@@ -109,7 +122,7 @@ void DataSource::onItemSelected(RecyclingGrid* recycler, size_t index)
             parent->dismiss();
           }
         },
-        onFocused));
+        onFocused, layerOf(subcategory)));
   }
 }
 
@@ -3,6 +3,10 @@
 
 #include <vector>
 
+#include "util/thumbnails.hpp"
+
+using namespace brls::literals; // for _i18n
+
 using namespace grid;
 
 RecyclerCell::RecyclerCell() { this->inflateFromXMLRes("xml/cells/icon_part_cell_grid.xml"); }
@@ -21,11 +25,46 @@ void RecyclerCell::onFocusGained()
   cb(img);
 }
 
+void RecyclerCell::draw(
+    NVGcontext* vg, float x, float y, float width, float height, brls::Style style, brls::FrameContext* ctx)
+{
+  if (loading)
+    SkeletonCell::drawSkeleton(vg, x, y, width, height, brls::Application::getTheme()["color/grey_3"], getAlpha());
+
+  RecyclingGridItem::draw(vg, x, y, width, height, style, ctx);
+}
+
+void RecyclerCell::load(
+    const std::string& path, size_t index, std::function<void(Image&&)> onLoaded, ContextPreview* context)
+{
+  loading         = true;
+  auto generation = ticket->load();
+
+  ASYNC_RETAIN
+  auto done = [ASYNC_TOKEN, index, generation, onLoaded](Image&& decoded) {
+    ASYNC_RELEASE
+    if (*ticket != generation || getIndex() != index)
+      return;
+
+    loading = false;
+    if (!decoded.data)
+      return;
+
+    image->setImageFromMemRGBA(decoded.data.get(), decoded.x, decoded.y);
+    if (onLoaded)
+      onLoaded(std::move(decoded));
+  };
+  if (context)
+    context->request(path, done);
+  else
+    DecodePool::instance().request(path, ticket, done, thumbnails::Size);
+}
+
 RecyclingGridItem* DataSource::cellForRow(RecyclingGrid* recycler, size_t index)
 {
   RecyclerCell* item = (RecyclerCell*)recycler->dequeueReusableCell("Cell");
   brls::Logger::debug("image: {}", files[index]);
-  item->image->setImageFromFile(files[index]);
+  item->load(files[index], index, nullptr, context);
   item->img = files[index];
   return item;
 }
@@ -40,6 +79,27 @@ void DataSource::onItemSelected(RecyclingGrid* recycler, size_t index)
   }
 }
 
+void DataSource::prefetchRows(RecyclingGrid* recycler, const std::vector<size_t>& indexes)
+{
+  // in context the raw thumbnails are not what gets shown
+  if (context)
+    return;
+
+  std::vector<std::string> paths;
+  paths.reserve(indexes.size());
+  for (auto index : indexes)
+    paths.push_back(files[index]);
+  DecodePool::instance().prefetch(std::move(paths), thumbnails::Size);
+}
+
+void DataSource::updateCell(RecyclingGridItem* item, size_t index)
+{
+  auto* cell = (RecyclerCell*)item;
+  // drop whatever the cell was still waiting for
+  ++*cell->ticket;
+  cell->load(files[index], index, nullptr, context);
+}
+
 size_t DataSource::getItemCount() { return files.size(); }
 
 void DataSource::clearData() { files.clear(); }
@@ -52,20 +112,47 @@ DataSource::DataSource(std::vector<std::string> files, std::function<void(std::s
 }
 
 IconPartSelectGrid::IconPartSelectGrid(const std::vector<std::string>& files, std::string title, ImageState& state,
-    std::function<void(std::string)> onSelected, std::function<void(std::string, ImageState& state)> onFocused)
+    std::function<void(std::string)> onSelected, std::function<void(std::string, ImageState& state)> onFocused,
+    std::optional<ImageState::Layer> layer)
+    : contextState(state)
+    , layer(layer)
 {
   this->inflateFromXMLRes("xml/views/icon_part_select_grid.xml");
 
   workingImage->setImageFromMemRGBA(state.working.data.get(), state.working.x, state.working.y);
   auto view = workingImage.getView();
-  recycler->registerCell("Cell", [view, &state, onFocused]() {
-    return RecyclerCell::create([view, &state, onFocused](std::string path) {
-      onFocused(path, state);
-      view->setImageFromMemRGBA(state.working.data.get(), state.working.x, state.working.y);
-    });
+  preview   = std::make_unique<PreviewPipeline>(state, onFocused,
+      [view](const Image& working) { view->setImageFromMemRGBA(working.data.get(), working.x, working.y); });
+  recycler->registerCell("Cell", [preview = preview.get()]() {
+    return RecyclerCell::create([preview](std::string path) { preview->request(path); });
   });
 
-  recycler->setDataSource(new DataSource(files, onSelected, this));
+  data = new DataSource(files, onSelected, this);
+  recycler->setDataSource(data);
+
+  if (layer) {
+    this->registerAction("app/main/preview_in_context"_i18n, brls::BUTTON_Y, [this](View* view) {
+      toggleContext();
+      return true;
+    });
+  }
 
   brls::sync([this, title]() { getAppletFrame()->setTitle(title); });
 }
+
+void IconPartSelectGrid::toggleContext()
+{
+  if (context) {
+    data->context = nullptr;
+  } else {
+    context       = std::make_unique<ContextPreview>(contextState, *layer);
+    data->context = context.get();
+  }
+
+  // the visible page is requested in one go, so it is composed as one batch
+  for (auto* item : recycler->getGridItems())
+    data->updateCell(item, item->getIndex());
+
+  if (!data->context)
+    context.reset();
+}
@@ -1,5 +1,6 @@
 #include "view/main_view.hpp"
 
+#include "util/catalog.hpp"
 #include "util/download.hpp"
 #include "util/paths.hpp"
 #include "util/uuid.hpp"
@@ -23,30 +24,11 @@ std::expected<std::vector<CategoryPart>, std::string> getCategories(std::string_
 {
   try {
     std::vector<CategoryPart> res;
-    auto categories = std::ranges::subrange(fs::directory_iterator(paths::IconCachePath), fs::directory_iterator {})
-        | std::views::filter([](const fs::directory_entry& entry) { return entry.is_directory(); })
-        | std::views::transform([](const fs::directory_entry& entry) { return entry.path(); })
-        | std::ranges::to<std::vector<fs::path>>();
-
-    for (auto& category : categories) {
-      auto path = category / subcategory;
-
-      if (fs::exists(path) && !fs::is_empty(path)) {
-        fs::path iconPath;
-        for (auto& file : fs::directory_iterator(category / "characters")) {
-          iconPath = file.path();
-          break;
-        }
-
-        if (!iconPath.empty()) {
-          brls::Logger::debug("category {}, image {}", category.string(), iconPath.string());
-          res.push_back(CategoryPart { category.filename(), iconPath.string() });
-        }
-      }
+    for (auto& category : catalog::categories(subcategory)) {
+      brls::Logger::debug("category {}, image {}", category.name, category.icon);
+      res.push_back(CategoryPart { category.name, category.icon });
     }
 
-    std::sort(res.begin(), res.end(), [](CategoryPart a, CategoryPart b) { return a.name < b.name; });
-
     if (res.empty()) {
       return std::unexpected("No categories found");
     } else {
@@ -165,7 +147,7 @@ MainView::MainView()
       // save to collection; hash beforehand to avoid duplicate copies
       auto path = fs::path(paths::CollectionPath) / (imageState.working.hash() + ".png");
       if (!fs::exists(path)) {
-        res = imageState.working.writePng(path);
+        res = imageState.working.writePng(path, Image::PngEncoder::FAST);
         brls::Logger::info("Writing to previous icons cache {}: {}", path.string(), res ? "success" : "failed");
       }
     }
@@ -4,10 +4,19 @@
 
 #include "view/recycling_grid.hpp"
 
+#include <algorithm>
 #include <borealis/core/touch/tap_gesture.hpp>
+#include <cmath>
 #include <utility>
+
+#include "util/allocations.hpp"
 // #include "view/button_refresh.hpp"
 
+// 每隔多少帧输出一次回收耗时统计
+constexpr size_t RecyclingStatsInterval = 600;
+// 预解码覆盖按当前滚动速度继续滚动多少帧的距离
+constexpr float PrefetchLookahead = 30;
+
 /// RecyclingGridItem
 
 RecyclingGridItem::RecyclingGridItem()
@@ -26,7 +35,11 @@ size_t RecyclingGridItem::getIndex() const { return this->index; }
 
 void RecyclingGridItem::setIndex(size_t value) { this->index = value; }
 
-RecyclingGridItem::~RecyclingGridItem() = default;
+RecyclingGridItem::~RecyclingGridItem()
+{
+  // parentUserdata 指向自身的 index，清空以免 View 析构时将其 free
+  this->setParent(this->getParent(), nullptr);
+}
 
 /// Skeleton cell
 
@@ -36,15 +49,23 @@ RecyclingGridItem* SkeletonCell::create() { return new SkeletonCell(); }
 
 void SkeletonCell::draw(
     NVGcontext* vg, float x, float y, float width, float height, brls::Style style, brls::FrameContext* ctx)
+{
+  drawSkeleton(vg, x, y, width, height, background, getAlpha());
+}
+
+void SkeletonCell::drawSkeleton(
+    NVGcontext* vg, float x, float y, float width, float height, NVGcolor background, float alpha)
 {
   brls::Time curTime = brls::getCPUTimeUsec() / 1000;
   float p            = (curTime % 1000) * 1.0 / 1000;
   p                  = fabs(0.5 - p) + 0.25;
 
+  NVGcolor start = background;
+  start.a *= alpha;
   NVGcolor end = background;
-  end.a        = p;
+  end.a        = p * alpha;
 
-  NVGpaint paint = nvgLinearGradient(vg, x, y, x + width, y + height, a(background), a(end));
+  NVGpaint paint = nvgLinearGradient(vg, x, y, x + width, y + height, start, end);
   nvgBeginPath(vg);
   nvgFillPaint(vg, paint);
   nvgRoundedRect(vg, x, y, width, height, 6);
@@ -130,6 +151,8 @@ RecyclingGrid::RecyclingGrid()
     this->reloadData();
   });
 
+  this->registerFloatXMLAttribute("preDecodeLine", [this](float value) { this->preDecodeLine = value; });
+
   this->registerBoolXMLAttribute("flowMode", [this](bool value) {
     this->spanCount  = 1;
     this->isFlowMode = value;
@@ -170,9 +193,42 @@ void RecyclingGrid::draw(
     NVGcontext* vg, float x, float y, float width, float height, brls::Style style, brls::FrameContext* ctx)
 {
   // 触摸或鼠标滑动时会导致屏幕元素位置变更
-  // 简单地在draw函数中调用itemsRecyclingLoop 实现动态的增删元素
-  // todo：只在滑动过程中调用 itemsRecyclingLoop 以节省静止时的计算消耗
-  itemsRecyclingLoop();
+  // 只有滚动位置变化，或布局、数据变化标记了 recyclingDirty 时才调用 itemsRecyclingLoop 增删元素
+  float offset = getContentOffsetY();
+  if (recyclingDirty || offset != lastContentOffsetY) {
+    // 数据或布局变化造成的跳变不计入滚动速度
+    if (!recyclingDirty) {
+      scrollVelocity = scrollVelocity * 0.7f + (offset - lastContentOffsetY) * 0.3f;
+      if (scrollVelocity > 0.5f)
+        scrollDirection = 1;
+      else if (scrollVelocity < -0.5f)
+        scrollDirection = -1;
+    }
+
+    recyclingDirty     = false;
+    lastContentOffsetY = offset;
+
+    brls::Time start = brls::getCPUTimeUsec();
+    size_t allocated = allocations::count();
+    itemsRecyclingLoop();
+    recyclingTime += brls::getCPUTimeUsec() - start;
+    recyclingAllocations += allocations::count() - allocated;
+    recyclingRuns++;
+
+    prefetchAhead();
+  }
+
+  if (++drawnFrames >= RecyclingStatsInterval) {
+    brls::Logger::debug(
+        "RecyclingGrid: recycled on {}/{} frames, {}us, {} cells added, {} allocations ({} in data source)",
+        recyclingRuns, drawnFrames, recyclingTime, addedCells, recyclingAllocations, sourceAllocations);
+    recyclingTime        = 0;
+    recyclingRuns        = 0;
+    drawnFrames          = 0;
+    addedCells           = 0;
+    recyclingAllocations = 0;
+    sourceAllocations    = 0;
+  }
 
   ScrollingFrame::draw(vg, x, y, width, height, style, ctx);
 
@@ -197,7 +253,10 @@ void RecyclingGrid::addCellAt(size_t index, bool downSide)
 {
   RecyclingGridItem* cell;
   // 获取到一个填充好数据的cell
-  cell = dataSource->cellForRow(this, index);
+  size_t allocated = allocations::count();
+  cell             = dataSource->cellForRow(this, index);
+  sourceAllocations += allocations::count() - allocated;
+  addedCells++;
 
   float cellHeight = estimatedRowHeight;
   float cellWidth  = (renderedFrame.getWidth() - getPaddingLeft() - getPaddingRight()) / spanCount
@@ -214,7 +273,7 @@ void RecyclingGrid::addCellAt(size_t index, bool downSide)
       if (cellHeight > estimatedRowHeight) {
         cellHeight = estimatedRowHeight;
       }
-      cellHeightCache[index] = cellHeight;
+      setCellHeight(index, cellHeight);
     } else {
       // dataSource 中指定了cell的高度，使用预定义的值
       cellHeight = cellHeightCache[index];
@@ -233,11 +292,10 @@ void RecyclingGrid::addCellAt(size_t index, bool downSide)
 
   this->contentBox->getChildren().insert(this->contentBox->getChildren().end(), cell);
 
-  // Allocate and set parent userdata
-  size_t* userdata = (size_t*)malloc(sizeof(size_t));
-  *userdata        = index;
+  pushVisibleCell(cell, visibleCount != 0 && index < visibleMin);
 
-  cell->setParent(this->contentBox, userdata);
+  // parent userdata 直接指向列表项自身的 index，不再为每次添加单独 malloc
+  cell->setParent(this->contentBox, &cell->index);
 
   // Layout and events
   this->contentBox->invalidate();
@@ -272,6 +330,7 @@ void RecyclingGrid::setDataSource(RecyclingGridDataSource* source)
   // 允许自动加载下一页
   this->requestNextPage = false;
   this->dataSource      = source;
+  this->recyclingDirty  = true;
   if (layouted)
     reloadData();
 }
@@ -280,16 +339,16 @@ void RecyclingGrid::reloadData()
 {
   if (!layouted)
     return;
+  recyclingDirty = true;
 
   // 将所有节点从屏幕上移除放入重复利用的列表中
-  auto children = this->contentBox->getChildren();
-  for (auto const& child : children) {
-    queueReusableCell((RecyclingGridItem*)child);
-    this->contentBox->removeView(child, false);
-  }
+  clearVisibleCells();
 
-  visibleMin = UINT_MAX;
-  visibleMax = 0;
+  // 新数据从顶部开始显示，先预解码下方的行
+  scrollVelocity  = 0;
+  scrollDirection = 1;
+  prefetchStart   = 0;
+  prefetchEnd     = 0;
 
   renderedFrame            = brls::Rect();
   renderedFrame.size.width = getWidth();
@@ -313,25 +372,23 @@ void RecyclingGrid::reloadData()
     // 这里添加首项是因为添加首项时会变更 renderedFrame 的 height 值，包括 itemsRecyclingLoop
     // 内的计算也都是以首项为基准进行的 原则上这里的 addCellAt 任意添加一项即可（比如添加第零项），但最好能添加到
     // cellFocusIndex 附近，这有助于提升首屏性能
-    size_t lineHeadIndex = cellFocusIndex / spanCount * spanCount;
-    // 更新 renderedFrame 数据，设置y的值，伪装成已经移除了 lineHeadIndex 项之前的列表项
-    // y 值表示当前列表渲染的顶部，低于 y 值高度的列表项不会被渲染
-    renderedFrame.origin.y = getHeightByCellIndex(lineHeadIndex);
-
-    // 添加 lineHeadIndex 项到需要渲染的列表项中，因为 lineHeadIndex 为一行的首项，在执行 addCellAt 之后会更新
-    // renderedFrame 数据 renderedFrame 的 height 调整为第 lineHeadIndex 项的高度
-    this->addCellAt(lineHeadIndex, true);
+    resetWindowAt(cellFocusIndex);
   } else {
     // 获取每个cell的高度并缓存起来
     cellHeightCache.clear();
+    std::vector<double> extents;
     for (size_t section = 0; section < dataSource->getItemCount(); section++) {
       float height = dataSource->heightForRow(this, section);
       cellHeightCache.push_back(height);
+      extents.push_back((height != -1 ? height : estimatedRowHeight) + estimatedRowSpace);
     }
+    cellHeightIndex.assign(extents);
+    firstUnknownHeight = std::find(cellHeightCache.begin(), cellHeightCache.end(), -1) - cellHeightCache.begin();
+
     contentBox->setHeight(getHeightByCellIndex(dataSource->getItemCount()) + paddingTop + paddingBottom);
-    // 流式布局无法准确确定焦点cell的位置，因此暂时只添加第一项，在 itemsRecyclingLoop 中会逐渐添加到
-    // cellFocusIndex，再按需删除 当 cellFocusIndex 过于大时，会导致添加的元素过多，因此需要考虑优化
-    this->addCellAt(0, true);
+    // 流式布局中高度未知的元素位置不准确，因此直接从焦点 cell 开始渲染（最多到第一个高度未知的元素），
+    // 其余项在 itemsRecyclingLoop 中逐渐添加
+    resetWindowAt(cellFocusIndex);
   }
 
   // 在前面的操作中，列表增加了一项，通过 selectRowAt 再精确地显示出具体选中项
@@ -349,6 +406,9 @@ void RecyclingGrid::notifyDataChanged()
       for (size_t i = cellHeightCache.size(); i < dataSource->getItemCount(); i++) {
         float height = dataSource->heightForRow(this, i);
         cellHeightCache.push_back(height);
+        cellHeightIndex.push((height != -1 ? height : estimatedRowHeight) + estimatedRowSpace);
+        if (firstUnknownHeight == i && height != -1)
+          firstUnknownHeight++;
       }
       contentBox->setHeight(getHeightByCellIndex(this->dataSource->getItemCount()) + paddingTop + paddingBottom);
     } else {
@@ -358,19 +418,47 @@ void RecyclingGrid::notifyDataChanged()
   }
   // 数据增多后重新允许加载下一页
   requestNextPage = false;
+  recyclingDirty  = true;
 }
 
 RecyclingGridItem* RecyclingGrid::getGridItemByIndex(size_t index)
 {
-  for (brls::View* i : contentBox->getChildren()) {
-    RecyclingGridItem* v = dynamic_cast<RecyclingGridItem*>(i);
-    if (!v)
-      continue;
-    if (v->getIndex() == index)
-      return v;
+  // 当前索引数据没有绑定列表项时返回 nullptr
+  return cellAt(index);
+}
+
+RecyclingGridItem* RecyclingGrid::cellAt(size_t index)
+{
+  if (visibleCount == 0 || index < visibleMin || index - visibleMin >= visibleCount)
+    return nullptr;
+  return visibleCells[(visibleHead + index - visibleMin) % visibleCells.size()];
+}
+
+void RecyclingGrid::pushVisibleCell(RecyclingGridItem* cell, bool front)
+{
+  if (visibleCount == visibleCells.size()) {
+    // 容量不足时翻倍，并按顺序重新排列；显示的列表项数量稳定后不会再进入这里
+    std::vector<RecyclingGridItem*> cells(std::max<size_t>(visibleCells.size() * 2, 16));
+    for (size_t i = 0; i < visibleCount; i++)
+      cells[i] = visibleCells[(visibleHead + i) % visibleCells.size()];
+    visibleCells.swap(cells);
+    visibleHead = 0;
   }
-  // 当前索引数据没有绑定列表项
-  return nullptr;
+
+  if (front) {
+    visibleHead               = (visibleHead + visibleCells.size() - 1) % visibleCells.size();
+    visibleCells[visibleHead] = cell;
+  } else {
+    visibleCells[(visibleHead + visibleCount) % visibleCells.size()] = cell;
+  }
+  visibleCount++;
+}
+
+void RecyclingGrid::popVisibleCell(bool front)
+{
+  if (front)
+    visibleHead = (visibleHead + 1) % visibleCells.size();
+  visibleCount--;
 }
 
 std::vector<RecyclingGridItem*>& RecyclingGrid::getGridItems()
@@ -417,14 +505,15 @@ void RecyclingGrid::itemsRecyclingLoop()
 
   brls::Rect visibleFrame = getVisibleFrame();
 
+  // 显示区域与已渲染的范围完全不重叠时（如快速拖动）直接跳转到对应位置
+  if (visibleCount != 0
+      && (visibleFrame.getMaxY() - paddingTop < renderedFrame.getMinY()
+          || visibleFrame.getMinY() - paddingTop > renderedFrame.getMaxY()))
+    resetWindowAt(getCellIndexByHeight(visibleFrame.getMinY() - paddingTop));
+
   // 上方元素自动销毁
   while (true) {
-    RecyclingGridItem* minCell = nullptr;
-    for (auto it : contentBox->getChildren())
-
-      // todo: contentBox 循环时加锁？it出现过空指针报错
-      if (*((size_t*)it->getParentUserData()) == visibleMin)
-        minCell = (RecyclingGridItem*)it;
+    RecyclingGridItem* minCell = cellAt(visibleMin);
 
     // 当第一个cell的顶部 与 组件顶部的距离大于 preFetchLine 行元素的距离时结束
     if (!minCell
@@ -442,6 +531,7 @@ void RecyclingGrid::itemsRecyclingLoop()
 
     queueReusableCell(minCell);
     this->contentBox->removeView(minCell, false);
+    popVisibleCell(true);
 
     brls::Logger::verbose("Cell #{} - destroyed", visibleMin);
 
@@ -450,11 +540,7 @@ void RecyclingGrid::itemsRecyclingLoop()
 
   // 下方元素自动销毁
   while (true) {
-    RecyclingGridItem* maxCell = nullptr;
-    // todo: contentBox 循环时加锁？it出现过空指针报错
-    for (auto it : contentBox->getChildren())
-      if (*((size_t*)it->getParentUserData()) == visibleMax)
-        maxCell = (RecyclingGridItem*)it;
+    RecyclingGridItem* maxCell = cellAt(visibleMax);
 
     // 当最后一个cell的顶部 与 组件底部间的距离 小于 preFetchLine 行元素的距离时结束
     if (!maxCell
@@ -470,6 +556,7 @@ void RecyclingGrid::itemsRecyclingLoop()
 
     queueReusableCell(maxCell);
     this->contentBox->removeView(maxCell, false);
+    popVisibleCell(false);
 
     brls::Logger::verbose("Cell #{} - destroyed", visibleMax);
 
@@ -532,15 +619,15 @@ void RecyclingGrid::setRefreshAction(const std::function<void()>& event)
 
 void RecyclingGrid::selectRowAt(size_t index, bool animated)
 {
+  // 目标不在显示范围内时直接跳转过去，而不是从当前位置逐项添加、删除
+  if (!animated && !cellAt(index) && dataSource && index < dataSource->getItemCount())
+    resetWindowAt(index);
+
   this->setContentOffsetY(getHeightByCellIndex(index), animated);
   this->itemsRecyclingLoop();
 
-  for (View* view : contentBox->getChildren()) {
-    if (*((size_t*)view->getParentUserData()) == index) {
-      contentBox->setLastFocusedView(view);
-      break;
-    }
-  }
+  if (RecyclingGridItem* cell = cellAt(index))
+    contentBox->setLastFocusedView(cell);
 }
 
 float RecyclingGrid::getHeightByCellIndex(size_t index, size_t start)
@@ -555,26 +642,110 @@ float RecyclingGrid::getHeightByCellIndex(size_t index, size_t start)
     return 0;
   }
 
-  if (start < 0)
-    start = 0;
-  if (index > this->cellHeightCache.size())
-    index = this->cellHeightCache.size();
+  return cellHeightIndex.prefix(index) - cellHeightIndex.prefix(start);
+}
+
+size_t RecyclingGrid::getCellIndexByHeight(float height)
+{
+  size_t count = dataSource ? dataSource->getItemCount() : 0;
+  if (count == 0 || height <= 0)
+    return 0;
+
+  size_t index;
+  if (isFlowMode)
+    index = cellHeightIndex.lowerBound(height);
+  else
+    index = (size_t)(height / (estimatedRowHeight + estimatedRowSpace)) * spanCount;
+  return index < count ? index : count - 1;
+}
+
+void RecyclingGrid::prefetchAhead()
+{
+  if (!dataSource || preDecodeLine <= 0 || visibleCount == 0)
+    return;
 
-  float res = 0;
-  for (size_t i = start; i < index && i < cellHeightCache.size(); i++) {
-    if (cellHeightCache[i] != -1)
-      res += cellHeightCache[i] + estimatedRowSpace;
-    else
-      res += estimatedRowHeight + estimatedRowSpace;
+  // 按当前速度估算接下来会出现的行数，至少 1 行，最多 preDecodeLine 行
+  float distance = std::abs(scrollVelocity) * PrefetchLookahead;
+  size_t rows    = (size_t)std::ceil(distance / (estimatedRowHeight + estimatedRowSpace));
+  rows           = std::clamp<size_t>(rows, 1, preDecodeLine);
+
+  size_t count  = dataSource->getItemCount();
+  size_t budget = rows * spanCount;
+  size_t start, end;
+  if (scrollDirection > 0) {
+    start = std::min<size_t>(visibleMax + 1, count);
+    end   = std::min(start + budget, count);
+  } else {
+    end   = visibleMin;
+    start = end > budget ? end - budget : 0;
   }
-  return res;
+  if (start >= end || (start == prefetchStart && end == prefetchEnd))
+    return;
+  prefetchStart = start;
+  prefetchEnd   = end;
+
+  // 由近及远排列
+  std::vector<size_t> indexes;
+  indexes.reserve(end - start);
+  for (size_t i = 0; i < end - start; i++)
+    indexes.push_back(scrollDirection > 0 ? start + i : end - 1 - i);
+  dataSource->prefetchRows(this, indexes);
+}
+
+void RecyclingGrid::setCellHeight(size_t index, float height)
+{
+  cellHeightCache[index] = height;
+  cellHeightIndex.set(index, height + estimatedRowSpace);
+  while (firstUnknownHeight < cellHeightCache.size() && cellHeightCache[firstUnknownHeight] != -1)
+    firstUnknownHeight++;
+}
+
+void RecyclingGrid::clearVisibleCells()
+{
+  // 只遍历环形缓冲区中有效的部分，其余位置可能是空指针或已回收的列表项
+  for (size_t i = 0; i < visibleCount; i++) {
+    RecyclingGridItem* cell = visibleCells[(visibleHead + i) % visibleCells.size()];
+    queueReusableCell(cell);
+    this->contentBox->removeView(cell, false);
+  }
+  visibleHead  = 0;
+  visibleCount = 0;
+
+  visibleMin = UINT_MAX;
+  visibleMax = 0;
+}
+
+void RecyclingGrid::resetWindowAt(size_t index)
+{
+  clearVisibleCells();
+
+  if (isFlowMode && index > firstUnknownHeight)
+    index = firstUnknownHeight;
+  if (index >= dataSource->getItemCount())
+    index = dataSource->getItemCount() - 1;
+
+  // 更新 renderedFrame 数据，设置y的值，伪装成已经移除了 lineHeadIndex 项之前的列表项
+  // y 值表示当前列表渲染的顶部，低于 y 值高度的列表项不会被渲染
+  size_t lineHeadIndex      = index / spanCount * spanCount;
+  renderedFrame.origin.y    = getHeightByCellIndex(lineHeadIndex);
+  renderedFrame.size.height = 0;
+
+  // 添加 lineHeadIndex 项到需要渲染的列表项中，因为 lineHeadIndex 为一行的首项，在执行 addCellAt 之后会更新
+  // renderedFrame 数据 renderedFrame 的 height 调整为第 lineHeadIndex 项的高度
+  this->addCellAt(lineHeadIndex, true);
 }
 
 void RecyclingGrid::forceRequestNextPage() { this->requestNextPage = false; }
 
 brls::View* RecyclingGrid::getNextCellFocus(brls::FocusDirection direction, brls::View* currentView)
 {
-  void* parentUserData = currentView->getParentUserData();
+  size_t currentIndex = ((RecyclingGridItem*)currentView)->getIndex();
+
+  // 焦点移动先于滚动发生，提前按移动方向预解码
+  if (direction == brls::FocusDirection::UP || direction == brls::FocusDirection::DOWN) {
+    scrollDirection = direction == brls::FocusDirection::DOWN ? 1 : -1;
+    prefetchAhead();
+  }
 
   // Allow up and down when axis is ROW
   if ((this->contentBox->getAxis() == brls::Axis::ROW && direction != brls::FocusDirection::LEFT
@@ -583,20 +754,18 @@ brls::View* RecyclingGrid::getNextCellFocus(brls::FocusDirection direction, brls
     if (direction == brls::FocusDirection::UP)
       row_offset = -spanCount;
     View* row_currentFocus       = nullptr;
-    size_t row_currentFocusIndex = *((size_t*)parentUserData) + row_offset;
+    size_t row_currentFocusIndex = currentIndex + row_offset;
 
     if (row_currentFocusIndex >= this->dataSource->getItemCount()) {
-      row_currentFocusIndex -= *((size_t*)parentUserData) % spanCount;
+      row_currentFocusIndex -= currentIndex % spanCount;
     }
 
-    while (
-        !row_currentFocus && row_currentFocusIndex >= 0 && row_currentFocusIndex < this->dataSource->getItemCount()) {
-      for (auto it : this->contentBox->getChildren()) {
-        if (*((size_t*)it->getParentUserData()) == row_currentFocusIndex) {
-          row_currentFocus = it->getDefaultFocus();
-          break;
-        }
-      }
+    // 只有显示范围内的列表项可以获取焦点
+    while (!row_currentFocus && row_currentFocusIndex < this->dataSource->getItemCount()) {
+      RecyclingGridItem* cell = cellAt(row_currentFocusIndex);
+      if (!cell)
+        break;
+      row_currentFocus = cell->getDefaultFocus();
       row_currentFocusIndex += row_offset;
     }
     if (row_currentFocus) {
@@ -608,7 +777,7 @@ brls::View* RecyclingGrid::getNextCellFocus(brls::FocusDirection direction, brls
   }
 
   if (this->contentBox->getAxis() == brls::Axis::ROW) {
-    int position = *((size_t*)parentUserData) % spanCount;
+    int position = currentIndex % spanCount;
     if ((direction == brls::FocusDirection::LEFT && position == 0)
         || (direction == brls::FocusDirection::RIGHT && position == (spanCount - 1))) {
       View* next = getParentNavigationDecision(this, nullptr, direction);
@@ -638,16 +807,14 @@ brls::View* RecyclingGrid::getNextCellFocus(brls::FocusDirection direction, brls
     offset = -1;
   }
 
-  size_t currentFocusIndex = *((size_t*)parentUserData) + offset;
+  size_t currentFocusIndex = currentIndex + offset;
   View* currentFocus       = nullptr;
 
-  while (!currentFocus && currentFocusIndex >= 0 && currentFocusIndex < this->dataSource->getItemCount()) {
-    for (auto it : this->contentBox->getChildren()) {
-      if (*((size_t*)it->getParentUserData()) == currentFocusIndex) {
-        currentFocus = it->getDefaultFocus();
-        break;
-      }
-    }
+  while (!currentFocus && currentFocusIndex < this->dataSource->getItemCount()) {
+    RecyclingGridItem* cell = cellAt(currentFocusIndex);
+    if (!cell)
+      break;
+    currentFocus = cell->getDefaultFocus();
     currentFocusIndex += offset;
   }
 
@@ -669,6 +836,7 @@ void RecyclingGrid::onLayout()
   if (!this->contentBox)
     return;
   this->contentBox->setWidth(width);
+  recyclingDirty = true;
   if (checkWidth()) {
     brls::Logger::debug("RecyclingGrid::onLayout reloadData()");
     layouted = true;
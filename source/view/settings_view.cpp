@@ -5,7 +5,9 @@
 
 #include "extern/json.hpp"
 #include "util/download.hpp"
+#include "util/pack.hpp"
 #include "util/paths.hpp"
+#include "util/thumbnails.hpp"
 #include "view/about_view.hpp"
 #include "view/download_view.hpp"
 
@@ -21,8 +23,8 @@ namespace fs = std::filesystem;
 
 void SettingsView::updateUI()
 {
-  cacheText->setText(
-      fs::is_directory(paths::IconCachePath) ? "app/settings/icon_cache/yes"_i18n : "app/settings/icon_cache/no"_i18n);
+  cacheText->setText(fs::is_directory(paths::IconCachePath) || pack::available() ? "app/settings/icon_cache/yes"_i18n
+                                                                                   : "app/settings/icon_cache/no"_i18n);
   checkText->setText(fmt::format(fmt::runtime("app/settings/icon_cache/last_checked"_i18n),
       cacheData.count("checkTime") ? cacheData["checkTime"] : "app/settings/icon_cache/never"_i18n));
   if (updateState == UpdateState::CHECK) {
@@ -54,6 +56,16 @@ SettingsView::SettingsView(SettingsData& settings)
         brls::sync([value]() { brls::Logger::info("extract check? {}", value ? "Overwrite" : "No Overwrite"); });
       });
 
+  extract_stream->init("app/settings/toggles/stream"_i18n, settings.streamDuringDownload, [&settings](bool value) {
+    settings.streamDuringDownload = value;
+    brls::sync([value]() { brls::Logger::info("extract while downloading? {}", value ? "Yes" : "No"); });
+  });
+
+  extract_pack->init("app/settings/toggles/pack"_i18n, settings.packIconCache, [&settings](bool value) {
+    settings.packIconCache = value;
+    brls::sync([value]() { brls::Logger::info("pack icons after extract? {}", value ? "Yes" : "No"); });
+  });
+
   about->registerClickAction([this](...) {
     this->present(new AboutView());
     return true;
@@ -85,18 +97,28 @@ SettingsView::SettingsView(SettingsData& settings)
 
         brls::Logger::info("Update check: sha {}, date {}", data["updateSha"], data["updateDate"]);
 
-        if (!cacheData.count("updateSha") || !fs::is_directory(paths::IconCachePath)
-            || fs::is_empty(paths::IconCachePath) || data["updateSha"] != cacheData["updateSha"]) {
+        auto cached = pack::available()
+            || (fs::is_directory(paths::IconCachePath) && !fs::is_empty(paths::IconCachePath));
+        if (!cacheData.count("updateSha") || !cached || data["updateSha"] != cacheData["updateSha"]) {
           brls::Logger::info("Update available: sha {}, date {}", data["updateSha"], data["updateDate"]);
           updateState = UpdateState::UPDATE;
         }
       }
     } else if (updateState == UpdateState::UPDATE) {
 
-      auto view = new DownloadView(DownloadPath, TempPath, std::string(paths::BasePath),
-          this->settings.overwriteDuringExtract, [this](std::string res) {
+      // an empty download path makes the view stream the archive instead of saving it first
+      auto view = new DownloadView(DownloadPath, this->settings.streamDuringDownload ? "" : TempPath,
+          std::string(paths::BasePath), this->settings.overwriteDuringExtract, this->settings.packIconCache,
+          [this](std::string res) {
+            if (!res.empty()) {
+              brls::Logger::error("Update not applied: {}", res);
+              brls::sync([this]() { updateUI(); });
+              return;
+            }
+
             updateState = UpdateState::CHECK;
             cacheData   = data;
+            thumbnails::setStamp(cacheData["updateSha"]);
 
             {
               std::fstream stream(std::string(paths::CacheFilePath), std::ios::out);
@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "util/allocations.hpp"
+#include "util/blend.hpp"
+#include "util/pixel_pool.hpp"
+
+// Built with COUNT_ALLOCATIONS. The pixel work of an ImageState refresh on the pooled path, replayed with PixelPool and
+// the blend kernels directly: three layers composited into a fresh output buffer, the alpha scaled, and the previous
+// frame dropped. Once the pool is warm none of it may allocate. ImageState and Image themselves are not covered; they
+// need borealis for stb_image and the pack reader, which a host build does not have.
+namespace {
+using Buffer = std::shared_ptr<unsigned char>;
+
+Buffer layer(unsigned char value)
+{
+  auto buffer = PixelPool::instance().acquire();
+  std::memset(buffer.get(), value, PixelPool::BufferSize);
+  return buffer;
+}
+
+Buffer compose(const Buffer& frame, const Buffer& character, const Buffer& background)
+{
+  constexpr size_t Pixels = PixelPool::BufferSize / 4;
+
+  auto output = PixelPool::instance().acquire();
+  blend::over(character.get(), background.get(), output.get(), Pixels);
+  blend::over(frame.get(), output.get(), output.get(), Pixels);
+  blend::scaleAlpha(output.get(), Pixels, 0.5f);
+  return output;
+}
+}
+
+int main()
+{
+  auto before = allocations::count();
+  std::make_unique<int>(0);
+  if (allocations::count() == before) {
+    std::printf("operator new is not being counted; build with COUNT_ALLOCATIONS\n");
+    return EXIT_FAILURE;
+  }
+
+  auto frame = layer(0x80), character = layer(0x40), background = layer(0xff);
+  auto current = compose(frame, character, background);
+
+  // the buffers the pool hands out after warming up
+  std::unordered_set<unsigned char*> warm;
+  for (int i = 0; i < 2; i++) {
+    current = compose(frame, character, background);
+    warm.insert(current.get());
+  }
+
+  before = allocations::count();
+  for (int i = 0; i < 200; i++) {
+    current = compose(frame, character, background);
+    if (!warm.contains(current.get())) {
+      std::printf("refresh %d composed into a buffer the pool did not recycle\n", i);
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto made = allocations::count() - before;
+  if (made != 0) {
+    std::printf("steady-state compositing made %zu allocations\n", made);
+    return EXIT_FAILURE;
+  }
+
+  std::printf("steady-state compositing makes no heap allocations\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "util/blend.hpp"
+
+namespace {
+#pragma pack(push, 1)
+struct Pixel {
+  uint8_t r, g, b, a;
+
+  static Pixel blend(const Pixel& a, const Pixel& b)
+  {
+    auto blender = [](uint8_t a, uint8_t b, uint8_t alpha) {
+      return static_cast<uint8_t>(((a * alpha) + (b * (255 - alpha))) / 255);
+    };
+
+    return Pixel { .r = blender(a.r, b.r, a.a), .g = blender(a.g, b.g, a.a), .b = blender(a.b, b.b, a.a), .a = 0xff };
+  }
+};
+#pragma pack(pop)
+
+// Image::merge as it was before blend::over, one pixel at a time
+Pixel mergeReference(const Pixel& frame, const Pixel& character, const Pixel& background)
+{
+  if (frame.a == 0xff)
+    return frame;
+  if (frame.a == 0 && character.a == 0xff)
+    return character;
+  if (frame.a == 0 && character.a == 0)
+    return background;
+  return Pixel::blend(frame, Pixel::blend(character, background));
+}
+
+// Image::merge as it is now; the row is split so every vector path also runs its scalar tail
+void merge(const Pixel* frame, const Pixel* character, const Pixel* background, Pixel* output, size_t pixels)
+{
+  auto* f = reinterpret_cast<const unsigned char*>(frame);
+  auto* c = reinterpret_cast<const unsigned char*>(character);
+  auto* b = reinterpret_cast<const unsigned char*>(background);
+  auto* o = reinterpret_cast<unsigned char*>(output);
+
+  for (size_t start = 0, end = 0; start < pixels; start = end) {
+    end = std::min(pixels, start + 101);
+    blend::over(c + start * 4, b + start * 4, o + start * 4, end - start);
+    blend::over(f + start * 4, o + start * 4, o + start * 4, end - start);
+  }
+}
+
+bool same(const Pixel& a, const Pixel& b) { return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a; }
+
+// every frame alpha against every character alpha, with each layer's channels running through all 256 values
+bool checkMerge()
+{
+  std::vector<Pixel> frame(256), character(256), background(256), output(256);
+
+  for (int fa = 0; fa < 256; fa++) {
+    for (int ca = 0; ca < 256; ca++) {
+      for (int v = 0; v < 256; v++) {
+        frame[v]      = Pixel { uint8_t(v), uint8_t(v * 3), uint8_t(v * 7), uint8_t(fa) };
+        character[v]  = Pixel { uint8_t(255 - v), uint8_t(v * 5), uint8_t(v ^ 0xa5), uint8_t(ca) };
+        background[v] = Pixel { uint8_t(v * 11), uint8_t(255 - v), uint8_t(v * 13), uint8_t(v) };
+      }
+
+      merge(frame.data(), character.data(), background.data(), output.data(), output.size());
+      for (int v = 0; v < 256; v++) {
+        auto expected = mergeReference(frame[v], character[v], background[v]);
+        if (!same(output[v], expected)) {
+          std::printf("merge mismatch: frame alpha %d, character alpha %d, value %d\n", fa, ca, v);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// a single over() for every top value, top alpha and bottom value, through the dispatching and the scalar kernel
+bool checkOver()
+{
+  std::vector<Pixel> top(256), bottom(256), output(256), scalar(256);
+
+  for (int alpha = 0; alpha < 256; alpha++) {
+    for (int b = 0; b < 256; b++) {
+      for (int t = 0; t < 256; t++) {
+        top[t]    = Pixel { uint8_t(t), uint8_t(255 - t), uint8_t(t ^ 0x5a), uint8_t(alpha) };
+        bottom[t] = Pixel { uint8_t(b), uint8_t(t), uint8_t(255 - b), uint8_t(b ^ t) };
+      }
+
+      auto* tp = reinterpret_cast<const unsigned char*>(top.data());
+      auto* bp = reinterpret_cast<const unsigned char*>(bottom.data());
+      blend::over(tp, bp, reinterpret_cast<unsigned char*>(output.data()), output.size());
+      blend::overScalar(tp, bp, reinterpret_cast<unsigned char*>(scalar.data()), scalar.size());
+
+      for (int t = 0; t < 256; t++) {
+        auto expected = Pixel::blend(top[t], bottom[t]);
+        if (alpha == 0)
+          expected.a = bottom[t].a;
+        if (!same(output[t], expected) || !same(scalar[t], expected)) {
+          std::printf("over mismatch: alpha %d, top %d, bottom %d\n", alpha, t, b);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+}
+
+int main()
+{
+  if (!checkOver() || !checkMerge())
+    return EXIT_FAILURE;
+
+  std::printf("blend::over matches the per-pixel merge\n");
+  return EXIT_SUCCESS;
+}
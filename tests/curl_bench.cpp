@@ -0,0 +1,140 @@
+#include <arpa/inet.h>
+#include <curl/curl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/curl_pool.hpp"
+
+// Per-request latency against a local keep-alive HTTP server, with a fresh easy handle per request as download.cpp
+// used to do and with CurlPool handles, then the pool from two threads at once as the main and download threads use
+// it. Fails if a request does not succeed or the pooled runs open more connections than they have threads.
+namespace {
+constexpr int Requests = 200;
+
+std::atomic_int connections = 0;
+
+// answers every request on a connection with a small fixed body until the client hangs up
+void serve(int client)
+{
+  static constexpr char Response[]
+      = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\n{}";
+
+  std::string pending;
+  char buffer[4096];
+  for (;;) {
+    auto read = recv(client, buffer, sizeof(buffer), 0);
+    if (read <= 0)
+      break;
+    pending.append(buffer, read);
+    for (size_t end; (end = pending.find("\r\n\r\n")) != std::string::npos;) {
+      pending.erase(0, end + 4);
+      if (send(client, Response, sizeof(Response) - 1, MSG_NOSIGNAL) < 0)
+        break;
+    }
+  }
+  close(client);
+}
+
+int listenLocal(int& port)
+{
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address {};
+  address.sin_family      = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length        = sizeof(address);
+  if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(server, 64) != 0
+      || getsockname(server, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+    return -1;
+
+  port = ntohs(address.sin_port);
+  std::thread([server]() {
+    for (int client; (client = accept(server, nullptr, nullptr)) >= 0;) {
+      connections++;
+      std::thread(serve, client).detach();
+    }
+  }).detach();
+  return server;
+}
+
+size_t discard(void*, size_t size, size_t count, void*) { return size * count; }
+
+// the options download::getRequest sets on every handle
+bool get(CURL* curl, const std::string& url)
+{
+  long status = 0;
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, "nso-icons");
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard);
+  return curl_easy_perform(curl) == CURLE_OK && curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status) == CURLE_OK
+      && status == 200;
+}
+
+template <typename F> bool run(const char* name, int threads, F request)
+{
+  std::atomic_bool failed = false;
+  std::vector<std::thread> workers;
+  connections = 0;
+  auto start  = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&]() {
+      for (int i = 0; i < Requests; i++) {
+        if (!request())
+          failed = true;
+      }
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  std::printf("%-28s %2d thread(s) %8.1f us/request %4d connection(s)\n", name, threads,
+      elapsed.count() / Requests / threads, connections.load());
+  if (failed)
+    std::printf("%s: a request failed\n", name);
+  return !failed;
+}
+}
+
+int main()
+{
+  int port = 0;
+  if (listenLocal(port) < 0) {
+    std::printf("cannot listen on the loopback interface\n");
+    return EXIT_FAILURE;
+  }
+
+  curl_global_init(CURL_GLOBAL_ALL);
+  auto url = "http://127.0.0.1:" + std::to_string(port) + "/api";
+
+  bool ok = run("fresh handle per request", 1, [&]() {
+    CURL* curl = curl_easy_init();
+    bool res   = get(curl, url);
+    curl_easy_cleanup(curl);
+    return res;
+  });
+
+  auto pooled = [&]() {
+    CurlPool::Handle curl;
+    return get(curl, url);
+  };
+  for (int threads : { 1, 2 }) {
+    ok = run("CurlPool", threads, pooled) && ok;
+    // a reused handle keeps its connection; at most one per handle the threads had out at once
+    if (connections > threads) {
+      std::printf("CurlPool: %d connections for %d thread(s)\n", connections.load(), threads);
+      ok = false;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,121 @@
+#include <png.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "extern/stb_image_write.h"
+#include "util/encode.hpp"
+
+// encode::png against stb_image_write, and encode::jpg against the temporary file account::setUserIcon used to go
+// through, on the bundled icon art and a synthetic 256x256 icon:
+//   encode_bench [png...]
+// The file path runs on the host's disk here; on the Switch every step of it is an SD card access.
+namespace fs = std::filesystem;
+
+namespace {
+constexpr int Rounds = 50;
+
+struct Pixels {
+  std::vector<unsigned char> data;
+  int x = 0, y = 0;
+
+  ImageView view() const { return { data.data(), x, y }; }
+};
+
+bool load(const char* path, Pixels& out)
+{
+  png_image image {};
+  image.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&image, path))
+    return false;
+
+  image.format = PNG_FORMAT_RGBA;
+  out.x        = image.width;
+  out.y        = image.height;
+  out.data.resize(PNG_IMAGE_SIZE(image));
+  return png_image_finish_read(&image, nullptr, out.data.data(), 0, nullptr) != 0;
+}
+
+// flat fills and soft edges over a transparent background, like a frame or character layer
+Pixels synthetic()
+{
+  Pixels res { std::vector<unsigned char>(256 * 256 * 4), 256, 256 };
+  for (int j = 0; j < 256; j++) {
+    for (int i = 0; i < 256; i++) {
+      auto* p = &res.data[(j * 256 + i) * 4];
+      int dx = i - 128, dy = j - 128, d = dx * dx + dy * dy;
+      if (d < 100 * 100)
+        p[0] = 200, p[1] = 120 + j / 4, p[2] = 40, p[3] = d < 96 * 96 ? 255 : 255 - (d - 96 * 96) / 4;
+    }
+  }
+  return res;
+}
+
+template <typename F> double measure(F encode, size_t& bytes)
+{
+  std::vector<unsigned char> out;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < Rounds; i++) {
+    out.clear();
+    encode(out);
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  bytes                                              = out.size();
+  return elapsed.count() / Rounds;
+}
+
+void bench(const std::string& name, const Pixels& image)
+{
+  size_t fastBytes = 0, stbBytes = 0;
+  auto fast = measure([&](std::vector<unsigned char>& out) { encode::png(image.view(), out); }, fastBytes);
+  auto stb  = measure(
+      [&](std::vector<unsigned char>& out) {
+        auto append = [](void* context, void* data, int size) {
+          auto* bytes = static_cast<unsigned char*>(data);
+          static_cast<std::vector<unsigned char>*>(context)->insert(
+              static_cast<std::vector<unsigned char>*>(context)->end(), bytes, bytes + size);
+        };
+        stbi_write_png_to_func(append, &out, image.x, image.y, 4, image.data.data(), 0);
+      },
+      stbBytes);
+
+  std::printf("%-24s %4dx%-4d encode::png %7.3f ms %7zu bytes | stb %7.3f ms %7zu bytes | %.1fx\n", name.c_str(),
+      image.x, image.y, fast, fastBytes, stb, stbBytes, stb / fast);
+
+  // write, stat, read back and delete, as setUserIcon did with tmpicon.jpg
+  auto file       = fs::temp_directory_path() / "encode_bench.jpg";
+  size_t jpgBytes = 0, fileBytes = 0;
+  auto memory     = measure([&](std::vector<unsigned char>& out) { encode::jpg(image.view(), out); }, jpgBytes);
+  auto roundTrip  = measure(
+      [&](std::vector<unsigned char>& out) {
+        stbi_write_jpg(file.c_str(), image.x, image.y, 4, image.data.data(), 90);
+        out.resize(fs::file_size(file));
+        std::ifstream(file, std::ios::binary).read(reinterpret_cast<char*>(out.data()), out.size());
+        fs::remove(file);
+      },
+      fileBytes);
+
+  std::printf("%-24s %4dx%-4d encode::jpg %7.3f ms %7zu bytes | file %6.3f ms %7zu bytes | %.1fx\n", "", image.x,
+      image.y, memory, jpgBytes, roundTrip, fileBytes, roundTrip / memory);
+}
+}
+
+int main(int argc, char** argv)
+{
+  bench("synthetic", synthetic());
+
+  for (int i = 1; i < argc; i++) {
+    Pixels image;
+    if (!load(argv[i], image)) {
+      std::printf("cannot read %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+    bench(std::string(argv[i]).substr(std::string(argv[i]).find_last_of('/') + 1), image);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include <png.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "util/encode.hpp"
+
+namespace {
+struct Pixels {
+  std::vector<unsigned char> data;
+  int x, y;
+
+  ImageView view() const { return { data.data(), x, y }; }
+};
+
+// gradients, flat runs, noise and transparent areas, so every Paeth predictor and long RLE runs both show up
+Pixels sample(int x, int y, unsigned seed)
+{
+  std::mt19937 random(seed);
+  Pixels res { std::vector<unsigned char>(static_cast<size_t>(x) * y * 4), x, y };
+  for (int j = 0; j < y; j++) {
+    for (int i = 0; i < x; i++) {
+      auto* p = &res.data[(static_cast<size_t>(j) * x + i) * 4];
+      switch ((i / 16 + j / 16) % 4) {
+        case 0:
+          p[0] = i, p[1] = j, p[2] = i + j, p[3] = 255;
+          break;
+        case 1:
+          p[0] = 40, p[1] = 80, p[2] = 120, p[3] = 255;
+          break;
+        case 2:
+          p[0] = random(), p[1] = random(), p[2] = random(), p[3] = random();
+          break;
+        default:
+          p[0] = random(), p[1] = 0, p[2] = 0, p[3] = 0;
+      }
+    }
+  }
+  return res;
+}
+
+bool decode(const std::vector<unsigned char>& png, Pixels& out)
+{
+  png_image image {};
+  image.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_memory(&image, png.data(), png.size()))
+    return false;
+
+  image.format = PNG_FORMAT_RGBA;
+  out.x        = image.width;
+  out.y        = image.height;
+  out.data.resize(PNG_IMAGE_SIZE(image));
+  return png_image_finish_read(&image, nullptr, out.data.data(), 0, nullptr) != 0;
+}
+
+bool roundTrip(const Pixels& source)
+{
+  std::vector<unsigned char> png { 0xde, 0xad }; // encode::png appends
+  Pixels decoded;
+  if (!encode::png(source.view(), png) || png[0] != 0xde || png[1] != 0xad) {
+    std::printf("%dx%d: encode failed\n", source.x, source.y);
+    return false;
+  }
+
+  png.erase(png.begin(), png.begin() + 2);
+  if (!decode(png, decoded) || decoded.x != source.x || decoded.y != source.y || decoded.data != source.data) {
+    std::printf("%dx%d: decoded pixels differ\n", source.x, source.y);
+    return false;
+  }
+  return true;
+}
+}
+
+int main()
+{
+  const int sizes[][2] = { { 1, 1 }, { 1, 7 }, { 5, 3 }, { 64, 64 }, { 256, 256 }, { 257, 129 }, { 1000, 40 } };
+
+  unsigned seed = 1;
+  for (auto& size : sizes) {
+    if (!roundTrip(sample(size[0], size[1], seed++)))
+      return EXIT_FAILURE;
+  }
+
+  std::vector<unsigned char> empty;
+  if (encode::png(ImageView(), empty)) {
+    std::printf("an empty view was encoded\n");
+    return EXIT_FAILURE;
+  }
+
+  std::printf("encode::png round trips losslessly\n");
+  return EXIT_SUCCESS;
+}
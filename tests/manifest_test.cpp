@@ -0,0 +1,130 @@
+#include <archive.h>
+#include <archive_entry.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "util/extract_entries.hpp"
+#include "util/manifest.hpp"
+
+// The delta update path against a local archive pair: extractEntries with a manifest over a first zip, then over a
+// second one that keeps, changes, adds and drops entries. Only the changed and new entries may be written, the dropped
+// one deleted, and the untouched one left alone, also when it is only present in the packs.
+namespace fs = std::filesystem;
+
+namespace {
+using Entries = std::map<std::string, std::string>;
+
+bool writeZip(const fs::path& file, const Entries& entries)
+{
+  std::unique_ptr<struct archive, decltype(&archive_write_free)> zip(archive_write_new(), archive_write_free);
+  archive_write_set_format_zip(zip.get());
+  if (archive_write_open_filename(zip.get(), file.c_str()) != ARCHIVE_OK)
+    return false;
+
+  for (auto& [name, content] : entries) {
+    std::unique_ptr<struct archive_entry, decltype(&archive_entry_free)> entry(archive_entry_new(), archive_entry_free);
+    archive_entry_set_pathname(entry.get(), name.c_str());
+    archive_entry_set_filetype(entry.get(), AE_IFREG);
+    archive_entry_set_perm(entry.get(), 0644);
+    archive_entry_set_size(entry.get(), content.size());
+    if (archive_write_header(zip.get(), entry.get()) != ARCHIVE_OK
+        || archive_write_data(zip.get(), content.data(), content.size()) != static_cast<la_ssize_t>(content.size()))
+      return false;
+  }
+  return archive_write_close(zip.get()) == ARCHIVE_OK;
+}
+
+extract::Result extractZip(const fs::path& file, const fs::path& workingPath, manifest::Manifest& manifest,
+    const std::function<bool(const fs::path&)>& exists = nullptr)
+{
+  std::unique_ptr<struct archive, decltype(&archive_read_free)> zip(archive_read_new(), archive_read_free);
+  archive_read_support_format_all(zip.get());
+  if (archive_read_open_filename(zip.get(), file.c_str(), 10240) != ARCHIVE_OK)
+    return {};
+  return extract::extractEntries(zip.get(), workingPath.string(), false, nullptr, &manifest, exists, false);
+}
+
+std::string contentOf(const fs::path& file)
+{
+  std::ifstream stream(file, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+bool check(bool condition, const char* what)
+{
+  if (!condition)
+    std::printf("%s\n", what);
+  return condition;
+}
+}
+
+int main()
+{
+  auto root     = fs::temp_directory_path() / ("manifest_test_" + std::to_string(getpid()));
+  auto cache    = root / "cache";
+  auto manifest = root / "manifest.bin";
+  fs::create_directories(root);
+
+  bool ok = writeZip(root / "v1.zip",
+                { { "icons/a/kept.png", "kept" }, { "icons/a/changed.png", "old" }, { "icons/b/dropped.png", "gone" } })
+      && writeZip(root / "v2.zip",
+          { { "icons/a/kept.png", "kept" }, { "icons/a/changed.png", "new" }, { "icons/b/added.png", "added" } });
+  if (!check(ok, "cannot write the test archives"))
+    return EXIT_FAILURE;
+
+  // the first update: no manifest yet, so everything is written
+  {
+    manifest::Manifest first(manifest);
+    ok       = check(!first.load() && first.size() == 0, "a manifest existed before the first pass");
+    auto res = extractZip(root / "v1.zip", cache, first);
+    ok       = ok && check(res.complete && res.written == 3 && res.skipped == 0, "the first pass did not write every entry")
+        && check(fs::exists(manifest), "the first pass saved no manifest");
+  }
+
+  // marks the unchanged file, so rewriting it would show
+  std::ofstream(cache / "icons/a/kept.png", std::ios::trunc) << "local";
+
+  if (ok) {
+    manifest::Manifest second(manifest);
+    ok       = check(second.load() && second.size() == 3, "the saved manifest did not load");
+    auto res = extractZip(root / "v2.zip", cache, second);
+    ok       = ok && check(res.complete, "the second pass did not complete")
+        && check(res.written == 2 && res.skipped == 1 && res.removed == 1, "the second pass counts are off")
+        && check(contentOf(cache / "icons/a/kept.png") == "local", "an unchanged entry was rewritten")
+        && check(contentOf(cache / "icons/a/changed.png") == "new", "a changed entry was not rewritten")
+        && check(contentOf(cache / "icons/b/added.png") == "added", "a new entry was not written")
+        && check(!fs::exists(cache / "icons/b/dropped.png"), "a dropped entry was not deleted");
+
+    manifest::Manifest third(manifest);
+    ok = ok && check(third.load() && third.size() == 3, "the second manifest does not list the new archive");
+  }
+
+  // a part served from the packs has no loose file, but still counts as in place
+  if (ok) {
+    auto packed = cache / "icons/a/kept.png";
+    fs::remove(packed);
+    manifest::Manifest fourth(manifest);
+    fourth.load();
+    auto res = extractZip(root / "v2.zip", cache, fourth,
+        [&packed](const fs::path& file) { return file == packed || fs::exists(file); });
+    ok       = check(res.complete && res.written == 0 && res.skipped == 3, "an unchanged packed entry was written")
+        && check(!fs::exists(packed), "an unchanged packed entry was written out loose");
+  }
+
+  std::error_code ec;
+  fs::remove_all(root, ec);
+  if (!ok)
+    return EXIT_FAILURE;
+
+  std::printf("the manifest rewrites only changed entries and deletes dropped ones\n");
+  return EXIT_SUCCESS;
+}
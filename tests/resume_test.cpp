@@ -0,0 +1,247 @@
+#include <arpa/inet.h>
+#include <curl/curl.h>
+#include <fmt/format.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "extern/json.hpp"
+#include "util/ranged_download.hpp"
+
+// ranged::probe and ranged::fetch against a local server: a server that ignores Range must not be downloaded by the
+// probe, and a ranged download killed partway (SIGKILL on a child process running it) must resume from its state file
+// into a byte-identical copy.
+//   resume_test                  runs the checks
+//   resume_test fetch URL FILE   the child: starts the download and runs until it is killed
+extern char** environ;
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr int64_t FileSize  = 4 << 20;
+constexpr int64_t PlainSize = 64 << 20;
+constexpr size_t Chunk      = 8 << 10;
+constexpr char ETag[]       = "\"v1\"";
+
+std::atomic_int64_t plainSent = 0;
+
+unsigned char byteAt(int64_t offset) { return static_cast<unsigned char>((offset * 7 + offset / 4093) & 0xff); }
+
+bool sendAll(int client, const void* data, size_t size)
+{
+  auto* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    auto sent = send(client, bytes, size, MSG_NOSIGNAL);
+    if (sent <= 0)
+      return false;
+    bytes += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+std::string header(const std::string& request, const std::string& name)
+{
+  auto start = request.find("\r\n" + name + ": ");
+  if (start == std::string::npos)
+    return "";
+  start += name.size() + 4;
+  return request.substr(start, request.find("\r\n", start) - start);
+}
+
+// /file takes ranges and trickles the body out so a transfer can be killed halfway; /plain always sends everything
+void serve(int client)
+{
+  std::string request;
+  char buffer[4096];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    auto read = recv(client, buffer, sizeof(buffer), 0);
+    if (read <= 0) {
+      close(client);
+      return;
+    }
+    request.append(buffer, read);
+  }
+
+  bool plain    = request.rfind("GET /plain ", 0) == 0;
+  int64_t size  = plain ? PlainSize : FileSize;
+  int64_t first = 0, last = size - 1;
+  auto range    = header(request, "Range");
+  auto ifRange  = header(request, "If-Range");
+  bool partial  = !plain && range.rfind("bytes=", 0) == 0 && (ifRange.empty() || ifRange == ETag);
+  if (partial) {
+    first = std::stoll(range.substr(6));
+    last  = std::min<int64_t>(std::stoll(range.substr(range.find('-') + 1)), size - 1);
+  }
+
+  auto head = partial
+      ? fmt::format("HTTP/1.1 206 Partial Content\r\nContent-Range: bytes {}-{}/{}\r\n", first, last, size)
+      : std::string("HTTP/1.1 200 OK\r\n");
+  head += fmt::format("ETag: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n", ETag, last - first + 1);
+  if (sendAll(client, head.data(), head.size())) {
+    std::vector<unsigned char> body;
+    for (int64_t offset = first; offset <= last; offset += body.size()) {
+      body.resize(std::min<int64_t>(Chunk, last - offset + 1));
+      for (size_t i = 0; i < body.size(); i++)
+        body[i] = byteAt(offset + i);
+      if (!sendAll(client, body.data(), body.size()))
+        break;
+      if (plain)
+        plainSent += body.size();
+      else
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  close(client);
+}
+
+int listenLocal(int& port)
+{
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address {};
+  address.sin_family      = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length        = sizeof(address);
+  if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(server, 64) != 0
+      || getsockname(server, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+    return -1;
+
+  port = ntohs(address.sin_port);
+  std::thread([server]() {
+    for (int client; (client = accept(server, nullptr, nullptr)) >= 0;)
+      std::thread(serve, client).detach();
+  }).detach();
+  return server;
+}
+
+int fetchChild(const std::string& url, const std::string& output)
+{
+  ranged::Probe info;
+  if (!ranged::probe(url, info) || !ranged::createFile(output, info.size))
+    return EXIT_FAILURE;
+  auto ranges = ranged::split(info.size, 2);
+  ranged::fetch(url, output, info, ranges, [](int64_t, int64_t) { return true; });
+  return EXIT_SUCCESS;
+}
+
+// bytes the child's state file says are on disk, or -1 while there is none to read
+int64_t savedBytes(const std::string& output)
+{
+  try {
+    std::ifstream stream(ranged::statePath(output));
+    auto state  = nlohmann::json::parse(stream);
+    int64_t res = 0;
+    for (auto& range : state["ranges"])
+      res += range[2].get<int64_t>();
+    return res;
+  } catch (const std::exception& e) {
+    return -1;
+  }
+}
+
+bool checkProbeStopsFullDownload(const std::string& base)
+{
+  ranged::Probe info;
+  if (ranged::probe(base + "/plain", info)) {
+    std::printf("probe accepted a server that ignores Range\n");
+    return false;
+  }
+
+  // whatever fit in the socket buffers before the probe hung up, not the whole body
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  if (plainSent >= PlainSize / 4) {
+    std::printf("probe pulled %lld of %lld bytes from a server that ignores Range\n",
+        static_cast<long long>(plainSent.load()), static_cast<long long>(PlainSize));
+    return false;
+  }
+  return true;
+}
+
+bool checkKillAndResume(std::string url, std::string output)
+{
+  std::string self = fs::read_symlink("/proc/self/exe").string();
+  char* argv[]     = { self.data(), const_cast<char*>("fetch"), url.data(), output.data(), nullptr };
+
+  pid_t child;
+  if (posix_spawn(&child, self.c_str(), nullptr, nullptr, argv, environ) != 0) {
+    std::printf("cannot start the download process\n");
+    return false;
+  }
+
+  // kill it once the state file shows a partial download
+  int64_t saved = -1;
+  for (int i = 0; i < 200 && saved <= 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    saved = savedBytes(output);
+  }
+  kill(child, SIGKILL);
+  waitpid(child, nullptr, 0);
+  if (saved <= 0 || saved >= FileSize) {
+    std::printf("the download was not caught partway (state: %lld bytes)\n", static_cast<long long>(saved));
+    return false;
+  }
+
+  ranged::Probe info;
+  auto ranges    = ranged::probe(url, info) ? ranged::loadState(output, url, info) : std::vector<ranged::Range>();
+  auto resumedAt = ranged::received(ranges);
+  if (ranges.empty() || resumedAt <= 0) {
+    std::printf("no resumable state after the kill\n");
+    return false;
+  }
+
+  for (int attempt = 0; attempt < 3 && !ranged::complete(ranges); attempt++)
+    ranged::fetch(url, output, info, ranges, [](int64_t, int64_t) { return true; });
+
+  std::ifstream stream(output, std::ios::binary);
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  bool same = ranged::complete(ranges) && static_cast<int64_t>(data.size()) == FileSize;
+  for (int64_t i = 0; same && i < FileSize; i++)
+    same = data[i] == byteAt(i);
+
+  std::printf("killed at %lld of %lld bytes, resumed from %lld\n", static_cast<long long>(saved),
+      static_cast<long long>(FileSize), static_cast<long long>(resumedAt));
+  if (!same)
+    std::printf("the resumed file differs from the served one\n");
+  return same;
+}
+}
+
+int main(int argc, char** argv)
+{
+  curl_global_init(CURL_GLOBAL_ALL);
+  if (argc == 4 && std::string(argv[1]) == "fetch")
+    return fetchChild(argv[2], argv[3]);
+
+  int port = 0;
+  if (listenLocal(port) < 0) {
+    std::printf("cannot listen on the loopback interface\n");
+    return EXIT_FAILURE;
+  }
+
+  auto base   = "http://127.0.0.1:" + std::to_string(port);
+  auto output = (fs::temp_directory_path() / fmt::format("resume_test_{}.bin", getpid())).string();
+  bool ok     = checkProbeStopsFullDownload(base) && checkKillAndResume(base + "/file", output);
+
+  std::error_code ec;
+  fs::remove(output, ec);
+  fs::remove(ranged::statePath(output), ec);
+  if (!ok)
+    return EXIT_FAILURE;
+
+  std::printf("ranged downloads resume byte-identical after a kill\n");
+  return EXIT_SUCCESS;
+}